@@ -1,16 +1,30 @@
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "subotto_metrics.hpp"
 #include "control.hpp"
 #include "analysis.hpp"
+#include "half_float.hpp"
+#include "parallel.hpp"
+#include "rod_profile.hpp"
 
 using namespace cv;
 using namespace std;
 
 int tableDiffLowFilterStdDev = 40;
 
-TableDescription::TableDescription(Size tableFrameSize) {
+TableDescription::TableDescription(Size tableFrameSize, bool compact) {
 
-  this->mean = Mat(tableFrameSize, CV_32FC3, Scalar(135.0/255.0, 150.0/255.0, 120.0/255.0));
-  this->variance = Mat(tableFrameSize, CV_32FC3, Scalar((20.0/255.0)*(20.0/255.0), (20.0/255.0)*(20.0/255.0), (20.0/255.0)*(20.0/255.0)));
+  Scalar initialMean(135.0/255.0, 150.0/255.0, 120.0/255.0);
+  Scalar initialVariance = Scalar::all((20.0/255.0)*(20.0/255.0));
+  // The running averages move by alpha times the change of the frame,
+  // which is mostly below the half float step, so they are always
+  // accumulated in full precision
+  this->mean = make_map(tableFrameSize, 3, initialMean, false);
+  this->variance = make_map(tableFrameSize, 3, initialVariance, false);
+  // What do_update_corrected_variance() would give for a flat mean
+  this->correctedVariance = make_map(tableFrameSize, 3, initialVariance + Scalar::all(0.002), compact);
 
 }
 
@@ -22,63 +36,612 @@ void TableDescription::set_first_frame(Mat firstFrame) {
 
 }
 
+static int tableDiffLowFilterBoxSize() {
+
+	return tableDiffLowFilterStdDev * 3 * sqrt(2 * CV_PI) / 4 + 0.5;
+
+}
+
+// Tiles are sized so that their rows of the table analysis buffers
+// (frame, diff, two low pass buffers, filteredDiff and filteredScatter)
+// stay in a 256 KiB L2 cache, but they are never thinner than the halo
+// of the low pass filter, otherwise each tile would spend most of the
+// filter time on the rows of its neighbours
+int choose_analysis_tiles(Size tableFrameSize) {
+
+	const int cacheBytes = 256 * 1024;
+	const int bytesPerPixel = 6 * 3 * sizeof(float);
+	int tileRows = cacheBytes / (bytesPerPixel * max(tableFrameSize.width, 1));
+	tileRows = max(tileRows, max(tableDiffLowFilterBoxSize() / 2, 1));
+	return max(1, (tableFrameSize.height + tileRows - 1) / tileRows);
+
+}
+
+// First part of the table analysis: diff and its low pass, stored in
+// low
+static void computeTableLowPass(const Mat &tableFrame,
+                                const TableDescription &table,
+                                TableAnalysis &tableAnalysis,
+                                Mat &low,
+                                int tiles) {
+
+	int n = tableFrame.cols * 3;
+	tableAnalysis.diff.create(tableFrame.size(), CV_32FC3);
+
+	for_each_tile(tableFrame.rows, tiles, [&](const Range &rows) {
+		vector< float > buf(n);
+		for (int y = rows.start; y < rows.end; y++) {
+			const float *frameRow = tableFrame.ptr< float >(y);
+			const float *meanRow = load_map_row(table.mean, y, buf.data());
+			float *diffRow = tableAnalysis.diff.ptr< float >(y);
+			for (int i = 0; i < n; i++) {
+				diffRow[i] = frameRow[i] - meanRow[i];
+			}
+		}
+	});
+
+	// Three box blurs, bouncing between two buffers. Each pass reads
+	// boxSize / 2 rows above and below its tile, which are taken from
+	// the whole source map because the tiles are ROIs of it, so the
+	// passes must be run one after the other.
+	low.create(tableFrame.size(), CV_32FC3);
+	Mat temp(tableFrame.size(), CV_32FC3);
+	int boxSize = tableDiffLowFilterBoxSize();
+	const Mat *passes[4] = { &tableAnalysis.diff, &low, &temp, &low };
+	for(int i = 0; i < 3; i++) {
+		for_each_tile(tableFrame.rows, tiles, [&](const Range &rows) {
+			Mat dst = passes[i+1]->rowRange(rows);
+			blur(passes[i]->rowRange(rows), dst, Size(boxSize, boxSize));
+		});
+	}
+
+}
+
 void do_table_analysis(control_panel_t &panel,
                        const Mat &tableFrame,
                        const TableDescription &table,
-                       TableAnalysis &tableAnalysis) {
+                       TableAnalysis &tableAnalysis,
+                       int tiles,
+                       const MotionTiles *motion,
+                       const TableAnalysis *prevTableAnalysis) {
+
+	if (prevTableAnalysis == NULL || prevTableAnalysis->nll.size() != tableFrame.size()) {
+		motion = NULL;
+	}
 
-	subtract(tableFrame, table.mean, tableAnalysis.diff);
+	int n = tableFrame.cols * 3;
+	tableAnalysis.filteredDiff.create(tableFrame.size(), CV_32FC3);
+	tableAnalysis.filteredScatter.create(tableFrame.size(), CV_32FC3);
+	tableAnalysis.nll.create(tableFrame.size(), CV_32F);
 
 	Mat low;
-	Mat temp;
-	tableAnalysis.diff.copyTo(temp);
-	int boxSize = tableDiffLowFilterStdDev * 3 * sqrt(2 * CV_PI) / 4 + 0.5;
+	computeTableLowPass(tableFrame, table, tableAnalysis, low, tiles);
+
+	// Sum over the channels of filteredScatter / correctedVariance + log(variance)
+	for_each_tile(tableFrame.rows, tiles, [&](const Range &rows) {
+		Mat filteredDiff = tableAnalysis.filteredDiff.rowRange(rows);
+		Mat filteredScatter = tableAnalysis.filteredScatter.rowRange(rows);
+		subtract(tableAnalysis.diff.rowRange(rows), low.rowRange(rows), filteredDiff);
+		multiply(filteredDiff, filteredDiff, filteredScatter);
+
+		vector< float > buf(n), buf2(n), logBuf(n);
+		for (int y = rows.start; y < rows.end; y++) {
+			float *nllRow = tableAnalysis.nll.ptr< float >(y);
+			if (motion != NULL && !motion->row_changed(y)) {
+				const float *prevRow = prevTableAnalysis->nll.ptr< float >(y);
+				copy(prevRow, prevRow + tableFrame.cols, nllRow);
+				continue;
+			}
+			const float *scatterRow = tableAnalysis.filteredScatter.ptr< float >(y);
+			const float *correctedRow = load_map_row(table.correctedVariance, y, buf.data());
+			const float *varianceRow = load_map_row(table.variance, y, buf2.data());
+			auto computeRun = [&](int start, int end, bool changed) {
+				if (!changed) {
+					const float *prevRow = prevTableAnalysis->nll.ptr< float >(y);
+					copy(prevRow + start, prevRow + end, nllRow + start);
+					return;
+				}
+				Mat logVariance(1, 3 * (end - start), CV_32F, logBuf.data() + 3 * start);
+				log(Mat(1, 3 * (end - start), CV_32F, (void*) (varianceRow + 3 * start)), logVariance);
+				const float *logRow = logBuf.data();
+				for (int x = start; x < end; x++) {
+					float sum = 0.f;
+					for (int c = 0; c < 3; c++) {
+						int i = 3 * x + c;
+						sum += scatterRow[i] / correctedRow[i] + logRow[i];
+					}
+					nllRow[x] = sum;
+				}
+			};
+			if (motion != NULL) {
+				motion->for_each_run(y, computeRun);
+			} else {
+				computeRun(0, tableFrame.cols, true);
+			}
+		}
+	});
+
+  dump_time(panel, "cycle", "table analysis");
+
+}
+
+
+// Per-pixel color models, shared by the lookup tables and by the pixel
+// classifier; the OpenCV float paths in do_ball_analysis() and
+// computeLL() compute the same thing on whole matrices
+static inline float ballLL(const BallDescription &ball, const float *color) {
+
+	float ll = 0.f;
+	for(int c = 0; c < 3; c++) {
+		float diff = color[c] - ball.meanColor[c];
+		ll -= diff * diff / ball.valueVariance;
+	}
+	return ll - log(ball.valueVariance);
+
+}
+
+static inline float foosmenDistance(const foosmen_params_t& params, int side, const float *color) {
+
+	const Scalar &mean = params.mean_color[side];
+	const Matx<float, 1, 6> &precision = params.color_precision[side];
+	float diff[3];
+	for(int c = 0; c < 3; c++) {
+		diff[c] = color[c] - mean[c];
+	}
+	float distance = 0.f;
 	for(int i = 0; i < 3; i++) {
-		blur(temp, low, Size(boxSize, boxSize));
-		low.copyTo(temp);
+		distance += precision(0, i) * diff[i] * diff[i];
 	}
-	subtract(tableAnalysis.diff, low, tableAnalysis.filteredDiff);
+	for(int i = 0; i < 3; i++) {
+		distance += precision(0, 3 + i) * diff[i] * diff[(i+1)%3];
+	}
+	return min(distance, params.nll_threshold);
 
-	multiply(tableAnalysis.filteredDiff, tableAnalysis.filteredDiff, tableAnalysis.filteredScatter);
+}
 
-	Mat tableDiffNorm = tableAnalysis.filteredScatter / table.correctedVariance;
+static void computeFoosmenDistanceRow(const float *in, float *out, int n, const foosmen_params_t& params, int side) {
 
-	Mat logVariance;
-	log(table.variance, logVariance);
+	int x = 0;
 
-	Mat notTableProb;
-	transform(tableDiffNorm + logVariance, notTableProb, Matx<float, 1, 3>(1, 1, 1));
+#ifdef __AVX2__
+	const __m256i channelOffsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	__m256 mean[3], precision[6];
+	for(int c = 0; c < 3; c++) {
+		mean[c] = _mm256_set1_ps(params.mean_color[side][c]);
+	}
+	for(int i = 0; i < 6; i++) {
+		precision[i] = _mm256_set1_ps(params.color_precision[side](0, i));
+	}
+	const __m256 threshold = _mm256_set1_ps(params.nll_threshold);
+	for(; x + 8 <= n; x += 8) {
+		__m256 diff[3];
+		for(int c = 0; c < 3; c++) {
+			diff[c] = _mm256_sub_ps(_mm256_i32gather_ps(in + 3 * x + c, channelOffsets, 4), mean[c]);
+		}
+		// Same order of the operations as foosmenDistance()
+		__m256 distance = _mm256_setzero_ps();
+		for(int i = 0; i < 3; i++) {
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_mul_ps(precision[i], diff[i]), diff[i]));
+		}
+		for(int i = 0; i < 3; i++) {
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_mul_ps(precision[3 + i], diff[i]), diff[(i+1)%3]));
+		}
+		_mm256_storeu_ps(out + x, _mm256_min_ps(distance, threshold));
+	}
+#endif
 
-	//Mat notTableProbTrunc;
-	float tableProbThresh = 20.f;
-	threshold(notTableProb, tableAnalysis.nll, tableProbThresh, 0, CV_THRESH_TRUNC);
-  notTableProb.copyTo(tableAnalysis.nll);
+	for(; x < n; x++) {
+		out[x] = foosmenDistance(params, side, in + 3 * x);
+	}
 
-  dump_time(panel, "cycle", "table analysis");
+}
+
+static Ptr< const ColorLUT > getBallLUT(ColorLUTCache &cache, const BallDescription &ball) {
+
+	vector< float > params;
+	for(int c = 0; c < 3; c++) {
+		params.push_back(ball.meanColor[c]);
+	}
+	params.push_back(ball.valueVariance);
+
+	return cache.get(params, [&](const Vec3f &color) {
+		return ballLL(ball, color.val);
+	});
+
+}
+
+static Ptr< const ColorLUT > getFoosmenLUT(ColorLUTCache &cache, const foosmen_params_t& params, int side) {
+
+	vector< float > key;
+	for(int c = 0; c < 3; c++) {
+		key.push_back(params.mean_color[side][c]);
+	}
+	for(int i = 0; i < 6; i++) {
+		key.push_back(params.color_precision[side](0, i));
+	}
+	key.push_back(params.nll_threshold);
+
+	return cache.get(key, [&](const Vec3f &color) {
+		return foosmenDistance(params, side, color.val);
+	});
+
+}
+
+
+void do_classify_pixels(control_panel_t &panel,
+                        const Mat &tableFrame,
+                        const TableDescription &table,
+                        const BallDescription &ball,
+                        const foosmen_params_t &foosmenParams,
+                        TableAnalysis &tableAnalysis,
+                        PixelClasses &classes,
+                        int tiles,
+                        color_luts_t *luts,
+                        const MotionTiles *motion,
+                        const PixelClasses *prevClasses,
+                        const Rect &ballWindow) {
+
+	int rows = tableFrame.rows;
+	int cols = tableFrame.cols;
+	int n = cols * 3;
+	if (prevClasses == NULL || prevClasses->planes.size() != Size(cols, CLASSES * rows)) {
+		motion = NULL;
+	}
+	classes.planes.create(CLASSES * rows, cols, CV_32F);
+	tableAnalysis.nll = classes.plane(TABLE_CLASS);
+
+	// The ball plane is only computed where do_ball_analysis() reads it,
+	// the window and one pixel around it; the previous one can only be
+	// reused for the same window
+	Rect frameRect(Point(), tableFrame.size());
+	Rect ballRoi = ballWindow.area() > 0 ? ballWindow & frameRect : frameRect;
+	classes.ballRect = Rect(ballRoi.x - 1, ballRoi.y - 1, ballRoi.width + 2, ballRoi.height + 2) & frameRect;
+	bool reuseBall = motion != NULL && prevClasses->ballRect == classes.ballRect;
+
+	Mat low;
+	computeTableLowPass(tableFrame, table, tableAnalysis, low, tiles);
+
+	Ptr< const ColorLUT > ballLUT, foosmenLUTs[2];
+	if (luts != NULL) {
+		ballLUT = getBallLUT(luts->ball, ball);
+		for(int side = 0; side < 2; side++) {
+			foosmenLUTs[side] = getFoosmenLUT(luts->foosmen[side], foosmenParams, side);
+		}
+	}
+
+	// The rest only depends on the pixel itself: each row of the frame
+	// and of the maps is read once, while it is in the L1 cache, and
+	// gives the rows of all the planes
+	for_each_tile(rows, tiles, [&](const Range &tileRows) {
+		vector< float > buf(n), buf2(n), logBuf(n);
+		for (int y = tileRows.start; y < tileRows.end; y++) {
+			float *planeRows[CLASSES];
+			for (int k = 0; k < CLASSES; k++) {
+				planeRows[k] = classes.planes.ptr< float >(k * rows + y);
+			}
+			const float *frameRow = tableFrame.ptr< float >(y);
+			float *ballRow = planeRows[BALL_CLASS];
+			bool ballInRow = y >= classes.ballRect.y && y < classes.ballRect.br().y;
+			int ballStart = ballInRow ? classes.ballRect.x : 0;
+			int ballEnd = ballInRow ? classes.ballRect.br().x : 0;
+
+			auto computeBallRun = [&](int start, int end) {
+				start = max(start, ballStart);
+				end = min(end, ballEnd);
+				if (start >= end) return;
+				if (ballLUT) {
+					ballLUT->apply_row(frameRow + 3 * start, ballRow + start, end - start);
+				} else {
+					for (int x = start; x < end; x++) {
+						ballRow[x] = ballLL(ball, frameRow + 3 * x);
+					}
+				}
+			};
+			auto copyRun = [&](int start, int end) {
+				for (int k = 0; k < CLASSES; k++) {
+					if (k == BALL_CLASS) continue;
+					const float *prevRow = prevClasses->planes.ptr< float >(k * rows + y);
+					copy(prevRow + start, prevRow + end, planeRows[k] + start);
+				}
+				if (reuseBall) {
+					const float *prevRow = prevClasses->planes.ptr< float >(BALL_CLASS * rows + y);
+					int ballCopyStart = max(start, ballStart);
+					int ballCopyEnd = min(end, ballEnd);
+					if (ballCopyStart < ballCopyEnd) {
+						copy(prevRow + ballCopyStart, prevRow + ballCopyEnd, ballRow + ballCopyStart);
+					}
+				} else {
+					computeBallRun(start, end);
+				}
+			};
+			if (motion != NULL && !motion->row_changed(y)) {
+				copyRun(0, cols);
+				continue;
+			}
+
+			const float *diffRow = tableAnalysis.diff.ptr< float >(y);
+			const float *lowRow = low.ptr< float >(y);
+			const float *correctedRow = load_map_row(table.correctedVariance, y, buf.data());
+			const float *varianceRow = load_map_row(table.variance, y, buf2.data());
+			float *nllRow = planeRows[TABLE_CLASS];
+			float *foosmenRows[2] = { planeRows[FOOSMEN_CLASS], planeRows[FOOSMEN_CLASS + 1] };
+
+			auto computeRun = [&](int start, int end, bool changed) {
+				if (!changed) {
+					copyRun(start, end);
+					return;
+				}
+				Mat logVariance(1, 3 * (end - start), CV_32F, logBuf.data() + 3 * start);
+				log(Mat(1, 3 * (end - start), CV_32F, (void*) (varianceRow + 3 * start)), logVariance);
+				const float *logRow = logBuf.data();
+				for (int x = start; x < end; x++) {
+					float sum = 0.f;
+					for (int c = 0; c < 3; c++) {
+						int i = 3 * x + c;
+						float filteredDiff = diffRow[i] - lowRow[i];
+						sum += filteredDiff * filteredDiff / correctedRow[i] + logRow[i];
+					}
+					nllRow[x] = sum;
+				}
+
+				computeBallRun(start, end);
+
+				for(int side = 0; side < 2; side++) {
+					if (foosmenLUTs[side]) {
+						foosmenLUTs[side]->apply_row(frameRow + 3 * start, foosmenRows[side] + start, end - start);
+					} else {
+						computeFoosmenDistanceRow(frameRow + 3 * start, foosmenRows[side] + start, end - start, foosmenParams, side);
+					}
+				}
+			};
+			if (motion != NULL) {
+				motion->for_each_run(y, computeRun);
+			} else {
+				computeRun(0, cols, true);
+			}
+		}
+	});
+
+  dump_time(panel, "cycle", "classify pixels");
 
 }
 
 
+// The log-likelihood of the ball and the density (before the blur) of
+// the pixels in rect
+static void computeBallProb(const Mat &tableFrame,
+                            const BallDescription& ball,
+                            const TableAnalysis& tableAnalysis,
+                            BallAnalysis& ballAnalysis,
+                            const ColorLUT *ballLUT,
+                            const PixelClasses *classes,
+                            const Rect &rect,
+                            Mat &pixelProb) {
+
+	Mat frame = tableFrame(rect);
+	Mat ll = ballAnalysis.ll(rect);
+	Mat prob = pixelProb(rect);
+
+	if (classes != NULL) {
+		// Already there
+	} else if (ballLUT != NULL) {
+		ballLUT->apply(frame, ll);
+	} else {
+		Mat diff = ballAnalysis.diff(rect);
+		Mat scatter = ballAnalysis.scatter(rect);
+
+		subtract(frame, ball.meanColor, diff);
+
+		multiply(diff, diff, scatter);
+
+		Mat ballDiffNorm = scatter / ball.valueVariance;
+
+		transform(ballDiffNorm, ll, -Matx<float, 1, 3>(1, 1, 1));
+		ll -= log(ball.valueVariance);
+	}
+
+	scaleAdd(ll, 0.5, tableAnalysis.nll(rect), prob);
+
+}
+
+// do_ball_analysis() on the changed tiles of roi only, the rest of ll
+// and of density being copied from the previous frame
+static void doGatedBallAnalysis(const Mat &tableFrame,
+                                const BallDescription& ball,
+                                const TableAnalysis& tableAnalysis,
+                                BallAnalysis& ballAnalysis,
+                                Mat& density,
+                                ColorLUTCache *lut,
+                                const PixelClasses *classes,
+                                const Rect &roi,
+                                const MotionTiles &motion,
+                                const BallAnalysis &prevBallAnalysis,
+                                const Mat &prevDensity) {
+
+	Rect frameRect(Point(), tableFrame.size());
+	Ptr< const ColorLUT > ballLUT;
+	if (classes != NULL) {
+		ballAnalysis.ll = classes->plane(BALL_CLASS);
+	} else {
+		prevBallAnalysis.ll.copyTo(ballAnalysis.ll);
+		if (lut != NULL) {
+			ballLUT = getBallLUT(*lut, ball);
+		} else {
+			ballAnalysis.diff.create(tableFrame.size(), CV_32FC3);
+			ballAnalysis.scatter.create(tableFrame.size(), CV_32FC3);
+		}
+	}
+	prevDensity.copyTo(density);
+	Mat pixelProb(tableFrame.size(), CV_32F);
+
+	vector< Rect > rects;
+	for (const Rect &rect : motion.get_changed_rects()) {
+		Rect r = rect & roi;
+		if (r.area() > 0) rects.push_back(r);
+	}
+	if (rects.empty()) return;
+
+	// The blur reads one pixel around each rectangle. The halos of the
+	// rectangles of the same row of tiles are apart, while those of two
+	// consecutive rows of tiles overlap, so even and odd rows are done
+	// in two rounds.
+	for (int parity = 0; parity < 2; parity++) {
+		parallel_for_range(Range(0, rects.size()), [&](const Range &range) {
+			for (int i = range.start; i < range.end; i++) {
+				const Rect &r = rects[i];
+				if ((r.y / motion.tile_size) % 2 != parity) continue;
+				Rect halo = Rect(r.x - 1, r.y - 1, r.width + 2, r.height + 2) & frameRect;
+				computeBallProb(tableFrame, ball, tableAnalysis, ballAnalysis, ballLUT.get(), classes, halo, pixelProb);
+			}
+		});
+	}
+	parallel_for_range(Range(0, rects.size()), [&](const Range &range) {
+		for (int i = range.start; i < range.end; i++) {
+			Mat dst = density(rects[i]);
+			blur(pixelProb(rects[i]), dst, Size(3, 3));
+		}
+	});
+
+	if (roi != frameRect) {
+		Mat inside = density(roi).clone();
+		double minDensity;
+		minMaxLoc(inside, &minDensity);
+		density.setTo(minDensity);
+		Mat dst = density(roi);
+		inside.copyTo(dst);
+	}
+
+}
+
 void do_ball_analysis(control_panel_t &panel,
                       const Mat &tableFrame,
                       const BallDescription& ball,
                       const TableAnalysis& tableAnalysis,
                       BallAnalysis& ballAnalysis,
-                      Mat& density) {
+                      Mat& density,
+                      int tiles,
+                      ColorLUTCache *lut,
+                      const PixelClasses *classes,
+                      const Rect &window,
+                      const MotionTiles *motion,
+                      const BallAnalysis *prevBallAnalysis,
+                      const Mat *prevDensity) {
+
+	// Only the window (plus the pixel read by the blur around it) is
+	// computed; the density elsewhere is set to its minimum inside
+	Rect frameRect(Point(), tableFrame.size());
+	Rect roi = window.area() > 0 ? window & frameRect : frameRect;
+	Rect halo = Rect(roi.x - 1, roi.y - 1, roi.width + 2, roi.height + 2) & frameRect;
+	Range roiCols(roi.x, roi.x + roi.width);
+
+	// With the motion gate, the previous results (which must come from
+	// the same window) are taken as they are and only the changed
+	// tiles are computed again
+	if (motion != NULL && prevBallAnalysis != NULL && prevDensity != NULL &&
+	    prevDensity->size() == tableFrame.size() && prevBallAnalysis->ll.size() == tableFrame.size()) {
+		doGatedBallAnalysis(tableFrame, ball, tableAnalysis, ballAnalysis, density, lut, classes, roi, *motion, *prevBallAnalysis, *prevDensity);
+		dump_time(panel, "cycle", "ball analysis");
+		return;
+	}
 
-	ballAnalysis.diff = tableFrame - ball.meanColor;
+	// With the lookup table or the classifier planes, diff and scatter
+	// are not computed
+	Ptr< const ColorLUT > ballLUT;
+	if (classes != NULL) {
+		ballAnalysis.ll = classes->plane(BALL_CLASS);
+	} else if (lut != NULL) {
+		ballLUT = getBallLUT(*lut, ball);
+	} else {
+		ballAnalysis.diff.create(tableFrame.size(), CV_32FC3);
+		ballAnalysis.scatter.create(tableFrame.size(), CV_32FC3);
+	}
+	ballAnalysis.ll.create(tableFrame.size(), CV_32F);
+	Mat pixelProb(tableFrame.size(), CV_32F);
+	density.create(tableFrame.size(), CV_32F);
+
+	for_each_tile(halo.height, tiles, [&](const Range &tile) {
+		Rect rect(halo.x, halo.y + tile.start, halo.width, tile.end - tile.start);
+		computeBallProb(tableFrame, ball, tableAnalysis, ballAnalysis, ballLUT.get(), classes, rect, pixelProb);
+	});
+
+	// The blur reads one row around each tile
+	for_each_tile(roi.height, tiles, [&](const Range &tile) {
+		Range rows(roi.y + tile.start, roi.y + tile.end);
+		Mat dst = density(rows, roiCols);
+		blur(pixelProb(rows, roiCols), dst, Size(3, 3));
+	});
+
+	if (roi != frameRect) {
+		Mat inside = density(roi).clone();
+		double minDensity;
+		minMaxLoc(inside, &minDensity);
+		density.setTo(minDensity);
+		Mat dst = density(roi);
+		inside.copyTo(dst);
+	}
 
-	multiply(ballAnalysis.diff, ballAnalysis.diff, ballAnalysis.scatter);
+  dump_time(panel, "cycle", "ball analysis");
 
-	Mat ballDiffNorm = ballAnalysis.scatter / ball.valueVariance;
+}
 
-	transform(ballDiffNorm, ballAnalysis.ll, -Matx<float, 1, 3>(1, 1, 1));
-	ballAnalysis.ll -= log(ball.valueVariance);
+void do_coarse_ball_analysis(control_panel_t &panel,
+                             const Mat &tableFrame,
+                             const BallDescription& ball,
+                             const TableAnalysis& tableAnalysis,
+                             BallAnalysis& ballAnalysis,
+                             Mat& density,
+                             int scale,
+                             ColorLUTCache *lut,
+                             const Rect &window) {
+
+	Size coarseSize(tableFrame.cols / scale, tableFrame.rows / scale);
+	Mat coarseFrame;
+	TableAnalysis coarseTable;
+	resize(tableFrame, coarseFrame, coarseSize, 0, 0, INTER_AREA);
+	resize(tableAnalysis.nll, coarseTable.nll, coarseSize, 0, 0, INTER_AREA);
+
+	Rect coarseWindow;
+	if (window.area() > 0) {
+		coarseWindow = Rect(Point(window.x / scale, window.y / scale),
+		                    Point((window.br().x + scale - 1) / scale, (window.br().y + scale - 1) / scale));
+	}
+	do_ball_analysis(panel, coarseFrame, ball, coarseTable, ballAnalysis, density, 1, lut, NULL, coarseWindow);
 
-	Mat pixelProb = 0.5 * ballAnalysis.ll + tableAnalysis.nll;
-	blur(pixelProb, density, Size(3, 3));
+}
 
-  dump_time(panel, "cycle", "ball analysis");
+void do_ball_density_patch(const Mat &tableFrame,
+                           const BallDescription& ball,
+                           const TableAnalysis& tableAnalysis,
+                           const Rect &patch,
+                           Mat& density,
+                           ColorLUTCache *lut,
+                           const PixelClasses *classes) {
+
+	// One more pixel around the patch for the blur; where the halo is
+	// cut by the frame border the blur reflects as on the whole frame
+	Rect frameRect(Point(), tableFrame.size());
+	Rect halo = Rect(patch.x - 1, patch.y - 1, patch.width + 2, patch.height + 2) & frameRect;
+
+	Mat ll;
+	if (classes != NULL) {
+		ll = classes->plane(BALL_CLASS)(halo);
+	} else if (lut != NULL) {
+		getBallLUT(*lut, ball)->apply(tableFrame(halo), ll);
+	} else {
+		ll.create(halo.size(), CV_32F);
+		for (int y = 0; y < halo.height; y++) {
+			const float *frameRow = tableFrame.ptr< float >(halo.y + y) + 3 * halo.x;
+			float *llRow = ll.ptr< float >(y);
+			for (int x = 0; x < halo.width; x++) {
+				llRow[x] = ballLL(ball, frameRow + 3 * x);
+			}
+		}
+	}
+
+	Mat prob, blurred;
+	scaleAdd(ll, 0.5, tableAnalysis.nll(halo), prob);
+	blur(prob, blurred, Size(3, 3));
+	blurred(Rect(patch.tl() - halo.tl(), patch.size())).copyTo(density);
 
 }
 
@@ -87,25 +650,78 @@ void do_update_table_description(control_panel_t &panel,
                                  const Mat &tableFrame,
                                  const TableAnalysis& tableAnalysis,
                                  TableDescription& table,
-				 const Mat &foosmen_mask) {
-
-  accumulateWeighted(tableFrame, table.mean, 0.005f, foosmen_mask);
-
-	Mat scatter;
-	multiply(tableAnalysis.diff, tableAnalysis.diff, scatter);
-	accumulateWeighted(scatter, table.variance, 0.005f, foosmen_mask);
+				 const FoosmenMask *foosmen_mask,
+                                 int tiles) {
+
+  const float alpha = 0.005f;
+
+  if (table.median) {
+    table.median->update(tableFrame, foosmen_mask, table.mean);
+  }
+
+  // Running averages of the frame and of the scatter, like
+  // accumulateWeighted() but skipping the foosmen runs
+  int n = tableFrame.cols * 3;
+  for_each_tile(tableFrame.rows, tiles, [&](const Range &rows) {
+      vector< float > meanBuf(n), varianceBuf(n);
+      vector< Range > spans;
+      for (int y = rows.start; y < rows.end; y++) {
+        const float *frameRow = tableFrame.ptr< float >(y);
+        const float *diffRow = tableAnalysis.diff.ptr< float >(y);
+        float *meanRow = table.median ? NULL : edit_map_row(table.mean, y, meanBuf.data());
+        float *varianceRow = edit_map_row(table.variance, y, varianceBuf.data());
+        auto updateRun = [&](int start, int end, bool masked) {
+          if (masked) return;
+          for (int i = 3 * start; i < 3 * end; i++) {
+            if (meanRow != NULL) {
+              meanRow[i] = (1.f - alpha) * meanRow[i] + alpha * frameRow[i];
+            }
+            varianceRow[i] = (1.f - alpha) * varianceRow[i] + alpha * diffRow[i] * diffRow[i];
+          }
+        };
+        if (foosmen_mask != NULL) {
+          foosmen_mask->for_each_run(y, tableFrame.cols, spans, updateRun);
+        } else {
+          updateRun(0, tableFrame.cols, false);
+        }
+        if (meanRow != NULL) {
+          store_map_row(table.mean, y, meanRow);
+        }
+        store_map_row(table.variance, y, varianceRow);
+      }
+    });
 
   dump_time(panel, "cycle", "update table description");
 
 }
 
 void do_update_corrected_variance(control_panel_t &panel,
-                                  TableDescription &table) {
+                                  TableDescription &table,
+                                  int bands) {
+
+	int rows = table.mean.rows;
+	int band = table.correctedVarianceBand % bands;
+	int y0 = band * rows / bands;
+	int y1 = (band + 1) * rows / bands;
+	table.correctedVarianceBand = (band + 1) % bands;
+
+	// The Laplacian needs one more row on each side; the band is taken
+	// as a ROI of the window, so filtering it gives the same values as
+	// filtering the whole map
+	int w0 = max(y0 - 1, 0);
+	int w1 = min(y1 + 1, rows);
+	Mat meanWindow, variance;
+	load_map(table.mean.rowRange(w0, w1), meanWindow);
+	load_map(table.variance.rowRange(y0, y1), variance);
 
 	Mat tableMeanLaplacian;
-	Laplacian(table.mean, tableMeanLaplacian, -1, 3);
+	Laplacian(meanWindow.rowRange(y0 - w0, y1 - w0), tableMeanLaplacian, -1, 3);
 	Mat tableMeanBorders = tableMeanLaplacian.mul(tableMeanLaplacian);
-	addWeighted(table.variance, 1, tableMeanBorders, 0.004, 0.002, table.correctedVariance);
+	Mat correctedVariance;
+	addWeighted(variance, 1, tableMeanBorders, 0.004, 0.002, correctedVariance);
+	for (int y = y0; y < y1; y++) {
+		store_map_row(table.correctedVariance, y, correctedVariance.ptr< float >(y - y0));
+	}
 
   dump_time(panel, "cycle", "update corrected variance");
 
@@ -121,6 +737,21 @@ float barx(int side, int bar, Size size, SubottoMetrics subottoMetrics, FoosmenM
 	return xx;
 }
 
+void init_foosmen_mask(FoosmenMask &mask, Size size, const SubottoMetrics &subottoMetrics, const FoosmenMetrics &foosmenMetrics) {
+	for(int side = 0; side < 2; side++) {
+		for(int bar = 0; bar < BARS; bar++) {
+			float xx = barx(side, bar, size, subottoMetrics, foosmenMetrics);
+
+			vector< float > centers;
+			for(int i = 0; i < foosmenMetrics.count[bar]; i++) {
+				float y = (0.5f + i - foosmenMetrics.count[bar] * 0.5f) * foosmenMetrics.distance[bar];
+				centers.push_back((0.5f + y / subottoMetrics.width) * size.height);
+			}
+			mask.add_rod(cvRound(xx - 20), cvRound(xx + 20), centers, 15);
+		}
+	}
+}
+
 static void computeFoosmenBarMetrics(SubottoMetrics subottoMetrics, FoosmenMetrics foosmenMetrics, int side, int bar, Size size, FoosmenBarMetrics& barMetrics, const foosmen_params_t& params) {
 	barMetrics.side = side;
 	barMetrics.bar = bar;
@@ -149,35 +780,89 @@ static void startFoosmenBarAnalysis(FoosmenBarMetrics barMetrics, FoosmenBarAnal
 	analysis.tableNLLSlice = tableAnalysis.nll(Range::all(), barMetrics.colRange);
 }
 
-static void computeScatter(const Mat& in, Mat& out) {
-	vector<Mat> inBGR;
-	split(in, inBGR);
+void foosmen_distance_blur(const Mat &slice, const foosmen_params_t& params, int side, Size ksize, Mat &out) {
+
+	assert(slice.type() == CV_32FC3);
+	const int rows = slice.rows;
+	const int cols = slice.cols;
+	const int kw = ksize.width;
+	const int kh = ksize.height;
+	const int ax = kw / 2;
+	const int ay = kh / 2;
+	out.create(slice.size(), CV_32F);
+
+	// Window rows j (from -ay to rows - 1 - ay + kh) go in slot j mod kh
+	// of the ring and come from row borderInterpolate(j) of the slice
+	vector< float > ring(kh * cols);
+	vector< double > colSum(cols, 0.0);
+	auto slot = [&](int j) { return &ring[(((j % kh) + kh) % kh) * cols]; };
+	auto enter = [&](int j) {
+		float *row = slot(j);
+		computeFoosmenDistanceRow(slice.ptr< float >(borderInterpolate(j, rows, BORDER_REFLECT_101)), row, cols, params, side);
+		for(int x = 0; x < cols; x++) {
+			colSum[x] += row[x];
+		}
+	};
+	auto leave = [&](int j) {
+		const float *row = slot(j);
+		for(int x = 0; x < cols; x++) {
+			colSum[x] -= row[x];
+		}
+	};
 
-	vector<Mat> outSplit;
+	vector< int > colIndex(cols + kw - 1);
+	for(int k = 0; k < cols + kw - 1; k++) {
+		colIndex[k] = borderInterpolate(k - ax, cols, BORDER_REFLECT_101);
+	}
+	const double scale = 1.0 / (kw * kh);
 
-	for(int i = 0; i < 3; i++) {
-		outSplit.push_back(inBGR[i].mul(inBGR[i]));
+	for(int j = -ay; j < kh - ay; j++) {
+		enter(j);
 	}
+	for(int y = 0; y < rows; y++) {
+		if (y > 0) {
+			leave(y - 1 - ay);
+			enter(y - 1 - ay + kh);
+		}
 
-	for(int i = 0; i < 3; i++) {
-		outSplit.push_back(inBGR[i].mul(inBGR[(i+1)%3]));
+		float *outRow = out.ptr< float >(y);
+		double sum = 0.0;
+		for(int k = 0; k < kw; k++) {
+			sum += colSum[colIndex[k]];
+		}
+		outRow[0] = sum * scale;
+		for(int x = 1; x < cols; x++) {
+			sum += colSum[colIndex[x - 1 + kw]] - colSum[colIndex[x - 1]];
+			outRow[x] = sum * scale;
+		}
 	}
 
-	merge(outSplit, out);
 }
 
-static void computeLL(FoosmenBarMetrics barMetrics, FoosmenBarAnalysis &analysis, const foosmen_params_t& params) {
-	analysis.diff = analysis.tableSlice - params.mean_color[barMetrics.side];
-	computeScatter(analysis.diff, analysis.scatter);
+void foosmen_plane_blur(const Mat &slice, Size ksize, Mat &out) {
 
-	Mat distance;
-	transform(analysis.scatter, distance, params.color_precision[barMetrics.side]);
+	// The slice is a view on the stacked planes: reflect at its border,
+	// as foosmen_distance_blur() does, instead of reading the rows of
+	// the neighbouring planes and the columns of the other bars
+	blur(slice, out, ksize, Point(-1, -1), BORDER_REFLECT_101 | BORDER_ISOLATED);
 
+}
+
+static void computeLL(FoosmenBarMetrics barMetrics, FoosmenBarAnalysis &analysis, const foosmen_params_t& params, const ColorLUT *lut, const PixelClasses *classes) {
 	Mat distanceTresh;
-	threshold(distance, distanceTresh, params.nll_threshold, 0, THRESH_TRUNC);
+	if (classes != NULL) {
+		distanceTresh = classes->plane(FOOSMEN_CLASS + barMetrics.side)(Range::all(), barMetrics.colRange);
+	} else if (lut != NULL) {
+		lut->apply(analysis.tableSlice, distanceTresh);
+	}
 
 	// TODO: subtract properly scaled analysis.tableNLLSlice
-	blur(distanceTresh, analysis.nll, Size(barMetrics.m2height * params.convolution_length, barMetrics.m2width * params.convolution_width));
+	Size ksize(barMetrics.m2height * params.convolution_length, barMetrics.m2width * params.convolution_width);
+	if (distanceTresh.empty()) {
+		foosmen_distance_blur(analysis.tableSlice, params, barMetrics.side, ksize, analysis.nll);
+	} else {
+		foosmen_plane_blur(distanceTresh, ksize, analysis.nll);
+	}
 }
 
 // Select the marginPixels-sized boxes centered at the foosmen's base
@@ -235,21 +920,63 @@ Point2f subpixelMinimum(control_panel_t &panel, Mat in) {
 	return Point2f(m.x + c.x, m.y + c.y);
 }
 
-static void findFoosmen(control_panel_t &panel, FoosmenBarMetrics barMetrics, FoosmenBarAnalysis &analysis, const foosmen_params_t& params, Mat &foosmen_mask) {
-	Point2f m;
-	m = subpixelMinimum(panel, analysis.overlapped);
-
+// m is the position of the minimum in the overlapped strip
+static void setFoosmenPosition(const FoosmenBarMetrics &barMetrics, FoosmenBarAnalysis &analysis, const foosmen_params_t& params, Point2f m) {
 	analysis.shift = (m.y - barMetrics.marginPixels / 2.f) / barMetrics.m2height;
 
 	float rotSin = (barMetrics.colRange.start + m.x - barMetrics.xPixels) * 2.f / barMetrics.m2width * params.rot_factor;
 	rotSin = max(-1.f, min(1.f, rotSin));
 	analysis.rot = asin(rotSin);
+}
+
+static void findFoosmen(control_panel_t &panel, FoosmenBarMetrics barMetrics, FoosmenBarAnalysis &analysis, const foosmen_params_t& params) {
+	Point2f m;
+	m = subpixelMinimum(panel, analysis.overlapped);
+
+	setFoosmenPosition(barMetrics, analysis, params, m);
 
 //	stringstream ss;
 //	ss << barMetrics.side << "-bar-" << barMetrics.bar;
 //	show(ss.str(), analysis.overlapped, 200);
 }
 
+// Same as computeOverlapped() and findFoosmen(), but the rows of the
+// overlapped strip are never summed up: the strip is reduced to its
+// row profile once, the shift is the minimum of the correlation of the
+// profile with the foosmen comb (only around the predicted shift when
+// prediction is given), and only the row of the overlapped strip at
+// that shift is summed up to find the rotation
+static void findFoosmenProjection(FoosmenBarMetrics barMetrics, FoosmenBarAnalysis &analysis, const foosmen_params_t& params, rod_prediction_t *prediction) {
+	int margin = barMetrics.marginPixels;
+	vector< float > offsets;
+	for(int i = 0; i < barMetrics.count; i++) {
+		float shift = -0.5f * (barMetrics.count - 1) + i;
+		float y = shift * barMetrics.distancePixels;
+		offsets.push_back(barMetrics.yPixels + y - barMetrics.marginPixels / 2);
+	}
+
+	Mat profile;
+	reduce(analysis.nll, profile, 1, REDUCE_SUM);
+	rod_search_params_t searchParams;
+	searchParams.predict = prediction != NULL;
+	searchParams.radius = params.predict_radius * barMetrics.m2height;
+	rod_prediction_t unpredicted;
+	rod_prediction_t &state = prediction != NULL ? *prediction : unpredicted;
+	float shift = search_rod_shift(profile.ptr< float >(), profile.rows, offsets, margin, false, searchParams, state);
+	int y = state.index;
+
+	vector< float > row(analysis.nll.cols, 0.f);
+	for(float offset : offsets) {
+		const float *nllRow = analysis.nll.ptr< float >(y + int(offset));
+		for(int x = 0; x < analysis.nll.cols; x++) {
+			row[x] += nllRow[x];
+		}
+	}
+	int x = min_element(row.begin(), row.end()) - row.begin();
+
+	setFoosmenPosition(barMetrics, analysis, params, Point2f(parabolic_peak(row.data(), row.size(), x), shift));
+}
+
 
 void do_foosmen_analysis(control_panel_t &panel,
                          FoosmenBarMetrics barsMetrics[BARS][2],
@@ -262,20 +989,43 @@ void do_foosmen_analysis(control_panel_t &panel,
                          const TableAnalysis& tableAnalysis,
                          float barsShift[BARS][2],
                          float barsRot[BARS][2],
-			 Mat &foosmen_mask) {
+                         ColorLUTCache *foosmenLUTs,
+                         const PixelClasses *classes,
+                         foosmen_predictions_t *predictions) {
+
+  Ptr< const ColorLUT > luts[2];
+  if (foosmenLUTs != NULL && classes == NULL) {
+    for(int side = 0; side < 2; side++) {
+      luts[side] = getFoosmenLUT(foosmenLUTs[side], foosmen_params, side);
+    }
+  }
+
+  // Each bar only reads the frame and writes its own metrics and
+  // analysis, so the bars are analyzed in parallel; the smoothing is
+  // done after all of them are finished
+  parallel_for_range(Range(0, 2 * BARS), [&](const Range &range) {
+      for(int i = range.start; i < range.end; i++) {
+        int side = i / BARS;
+        int bar = i % BARS;
+        FoosmenBarMetrics& barMetrics = barsMetrics[bar][side];
+        FoosmenBarAnalysis& analysis = barsAnalysis[bar][side];
+
+        computeFoosmenBarMetrics(metrics, foosmenMetrics, side, bar, size, barMetrics, foosmen_params);
+
+        startFoosmenBarAnalysis(barMetrics, analysis, tableFrame, tableAnalysis);
+        computeLL(barMetrics, analysis, foosmen_params, luts[side].get(), classes);
+        if (foosmen_params.projection_estimator) {
+          findFoosmenProjection(barMetrics, analysis, foosmen_params, predictions != NULL ? &predictions->bars[bar][side] : NULL);
+        } else {
+          computeOverlapped(barMetrics, analysis);
+          findFoosmen(panel, barMetrics, analysis, foosmen_params);
+        }
+      }
+    }, 2 * BARS);
 
-  foosmen_mask = Mat(tableFrame.size(), CV_8UC1, Scalar(255));
 		for(int side = 0; side < 2; side++) {
 			for(int bar = 0; bar < BARS; bar++) {
-				FoosmenBarMetrics& barMetrics = barsMetrics[bar][side];
-				FoosmenBarAnalysis& analysis = barsAnalysis[bar][side];
-
-				computeFoosmenBarMetrics(metrics, foosmenMetrics, side, bar, size, barMetrics, foosmen_params);
-
-				startFoosmenBarAnalysis(barMetrics, analysis, tableFrame, tableAnalysis);
-				computeLL(barMetrics, analysis, foosmen_params);
-				computeOverlapped(barMetrics, analysis);
-				findFoosmen(panel, barMetrics, analysis, foosmen_params, foosmen_mask);
+				const FoosmenBarAnalysis& analysis = barsAnalysis[bar][side];
 
 				float& shift = barsShift[bar][side];
 				float& rot = barsRot[bar][side];
@@ -5,15 +5,37 @@
 
 #include "opencv2/imgproc/imgproc.hpp"
 
+#include "color_lut.hpp"
+#include "rod_profile.hpp"
+#include "foosmen_mask.hpp"
+#include "motion_gate.hpp"
+#include "median_background.hpp"
+
 using namespace std;
 using namespace cv;
 
+struct PixelClasses;
+
+enum background_model_t {
+	RUNNING_AVERAGE,
+	RUNNING_MEDIAN
+};
+
 struct TableDescription {
 	Mat mean;
 	Mat variance;
 	Mat correctedVariance;
+	// Next band of rows refreshed by do_update_corrected_variance()
+	int correctedVarianceBand = 0;
+
+  // Only used with the RUNNING_MEDIAN background model; when present,
+  // mean is its median estimate instead of a running average
+  Ptr< MedianBackground > median;
 
-  TableDescription(Size tableFrameSize);
+  // When compact, correctedVariance is stored as half floats (see
+  // half_float.hpp) and converted on the fly by the kernels; mean and
+  // variance are always in full precision
+  TableDescription(Size tableFrameSize, bool compact = false);
   void set_first_frame(Mat firstFrame);
 };
 
@@ -25,10 +47,22 @@ struct TableAnalysis {
 };
 
 
+// The per-pixel analysis functions below can split the table frame in
+// horizontal tiles processed in parallel (see for_each_tile()); the
+// results are the same for any number of tiles. When given the tiles
+// changed according to the motion gate and the results of the previous
+// frame, they only compute the changed tiles and take the others from
+// the previous results (the low pass of the table diff is still
+// computed everywhere, as it reads far around each pixel).
+int choose_analysis_tiles(Size tableFrameSize);
+
 void do_table_analysis(control_panel_t &panel,
                        const Mat &tableFrame,
                        const TableDescription &table,
-                       TableAnalysis &tableAnalysis);
+                       TableAnalysis &tableAnalysis,
+                       int tiles = 1,
+                       const MotionTiles *motion = NULL,
+                       const TableAnalysis *prevTableAnalysis = NULL);
 
 
 struct BallDescription {
@@ -48,17 +82,52 @@ void do_ball_analysis(control_panel_t &panel,
                       const BallDescription& ball,
                       const TableAnalysis& tableAnalysis,
                       BallAnalysis& ballAnalysis,
-                      Mat& density);
+                      Mat& density,
+                      int tiles = 1,
+                      ColorLUTCache *lut = NULL,
+                      const PixelClasses *classes = NULL,
+                      const Rect &window = Rect(),
+                      const MotionTiles *motion = NULL,
+                      const BallAnalysis *prevBallAnalysis = NULL,
+                      const Mat *prevDensity = NULL);
+
+// do_ball_analysis() on the table frame and the table NLL downscaled
+// by scale (window is in full resolution pixels); the results have
+// the downscaled size
+void do_coarse_ball_analysis(control_panel_t &panel,
+                             const Mat &tableFrame,
+                             const BallDescription& ball,
+                             const TableAnalysis& tableAnalysis,
+                             BallAnalysis& ballAnalysis,
+                             Mat& density,
+                             int scale,
+                             ColorLUTCache *lut = NULL,
+                             const Rect &window = Rect());
+
+// The density of do_ball_analysis() computed in patch only, at full
+// resolution; density gets the size of patch
+void do_ball_density_patch(const Mat &tableFrame,
+                           const BallDescription& ball,
+                           const TableAnalysis& tableAnalysis,
+                           const Rect &patch,
+                           Mat& density,
+                           ColorLUTCache *lut = NULL,
+                           const PixelClasses *classes = NULL);
 
 
 void do_update_table_description(control_panel_t &panel,
                                  const Mat &tableFrame,
                                  const TableAnalysis& tableAnalysis,
                                  TableDescription& table,
-				 const Mat &foosmen_mask);
+				 const FoosmenMask *foosmen_mask,
+                                 int tiles = 1);
 
+// Refresh correctedVariance one horizontal band at a time: each call
+// recomputes the next of bands bands, so that the whole map is renewed
+// every bands calls at a constant cost per call
 void do_update_corrected_variance(control_panel_t &panel,
-                                  TableDescription &table);
+                                  TableDescription &table,
+                                  int bands = 1);
 
 
 enum {
@@ -120,8 +189,6 @@ struct FoosmenBarAnalysis {
 	Mat tableSlice;
 	Mat tableNLLSlice;
 
-	Mat diff;
-	Mat scatter;
 	Mat nll;
 
 	Mat overlapped;
@@ -146,10 +213,90 @@ struct foosmen_params_t {
 	float rot_factor = 40.f;
 
 	float nll_threshold = 2.f;
+
+	// Find the bar shift from the 1-D profile of the bar strip (see
+	// rod_profile.hpp) instead of the minimum of the overlapped strip
+	bool projection_estimator = true;
+	// Half width of the window searched around the predicted shift (m),
+	// see foosmen_predictions_t
+	float predict_radius = 0.01f;
+};
+
+// The foosmen color distance of each pixel of slice (the quadratic
+// form of color_precision[side] on the difference from
+// mean_color[side], truncated at nll_threshold) blurred with a ksize
+// box filter, as blur() would do it. Everything is done in a single
+// pass over slice: the distance rows are computed (with AVX2 eight
+// pixels at a time) into a ring buffer as the vertical window of the
+// filter reaches them, and the filter keeps running sums in doubles.
+void foosmen_distance_blur(const Mat &slice, const foosmen_params_t& params, int side, Size ksize, Mat &out);
+
+// Tabulated versions of the ball and foosmen color models (see
+// color_lut.hpp), shared by all the frames; when given, the analysis
+// functions use them instead of computing the models on each pixel
+struct color_luts_t {
+	ColorLUTCache ball;
+	ColorLUTCache foosmen[2];
+};
+
+// Likelihood planes of the classes a table frame pixel can belong to,
+// stacked in a single CV_32F buffer of CLASSES * rows rows
+enum {
+	TABLE_CLASS, // same as TableAnalysis::nll
+	BALL_CLASS, // same as BallAnalysis::ll
+	FOOSMEN_CLASS, // truncated color distance of side 0 foosmen, then side 1
+	CLASSES = FOOSMEN_CLASS + 2
+};
+
+struct PixelClasses {
+	Mat planes;
+	// Part of the ball plane that is computed, the rest is undefined
+	Rect ballRect;
+
+	Mat plane(int c) const {
+		int rows = this->planes.rows / CLASSES;
+		return this->planes.rowRange(c * rows, (c + 1) * rows);
+	}
+};
+
+// blur() of the foosmen plane of PixelClasses on the columns of a bar,
+// which gives what foosmen_distance_blur() gives on the same columns of
+// the table frame
+void foosmen_plane_blur(const Mat &slice, Size ksize, Mat &out);
+
+// Replaces do_table_analysis() and the color models of
+// do_ball_analysis() and do_foosmen_analysis(): after the low pass of
+// the table diff, each pixel is read once to fill all the planes of
+// classes (tableAnalysis.nll points to the table plane). Pass the
+// planes to the other analysis functions to use them. The ball plane
+// is only computed around ballWindow (all of it when empty), which must
+// be the window given then to do_ball_analysis().
+void do_classify_pixels(control_panel_t &panel,
+                        const Mat &tableFrame,
+                        const TableDescription &table,
+                        const BallDescription &ball,
+                        const foosmen_params_t &foosmenParams,
+                        TableAnalysis &tableAnalysis,
+                        PixelClasses &classes,
+                        int tiles = 1,
+                        color_luts_t *luts = NULL,
+                        const MotionTiles *motion = NULL,
+                        const PixelClasses *prevClasses = NULL,
+                        const Rect &ballWindow = Rect());
+
+// State of the predictive search of the bar shifts, carried from frame
+// to frame; when given to do_foosmen_analysis() (with the projection
+// estimator), each bar is searched only around its predicted shift,
+// falling back to the whole strip on a poor match
+struct foosmen_predictions_t {
+	rod_prediction_t bars[BARS][2];
 };
 
 Point2f subpixelMinimum(control_panel_t &panel, Mat in);
 float barx(int side, int bar, Size size, SubottoMetrics subottoMetrics, FoosmenMetrics foosmenMetrics);
+// Adds the stamps of the bars to mask, with rod side * BARS + bar;
+// the shift of a rod is then barsShift / subottoMetrics.width * size.height
+void init_foosmen_mask(FoosmenMask &mask, Size size, const SubottoMetrics &subottoMetrics, const FoosmenMetrics &foosmenMetrics);
 void do_foosmen_analysis(control_panel_t &panel,
                          FoosmenBarMetrics barsMetrics[BARS][2],
                          FoosmenBarAnalysis barsAnalysis[BARS][2],
@@ -161,6 +308,8 @@ void do_foosmen_analysis(control_panel_t &panel,
                          const TableAnalysis& tableAnalysis,
                          float barsShift[BARS][2],
                          float barsRot[BARS][2],
-			 Mat &foosmen_mask);
+                         ColorLUTCache *foosmenLUTs = NULL,
+                         const PixelClasses *classes = NULL,
+                         foosmen_predictions_t *predictions = NULL);
 
 #endif /* ANALYSIS_HPP_ */
@@ -0,0 +1,930 @@
+#ifndef BASIC_SPOTS_TRACKER_HPP_
+#define BASIC_SPOTS_TRACKER_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "binary_io.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// The ball tracker shared by the command line programs and by the Qt
+// one. It is a template on the cost model, the policy that gives the
+// parameters of the cost of the paths: with RuntimeSpotsCosts they can
+// be changed while tracking, with FixedSpotsCosts they are constants
+// the compiler folds into the jump costs.
+
+// The parameters of the production tracker
+struct FixedSpotsCosts {
+  static constexpr double appearance_badness() { return 400.0; }
+  static constexpr double disappearance_badness() { return 400.0; }
+  static constexpr double absence_badness() { return -10.0; }
+  static constexpr double max_speed() { return 18.0; }
+  static constexpr double max_unseen_distance() { return 0.3; }
+  // Per second of skipped frames
+  static constexpr double skip_badness() { return -960.0; }
+  static constexpr double variance_parameter() { return 0.3; }
+};
+
+// The same parameters, as variables that can be bound to trackbars
+struct RuntimeSpotsCosts {
+  double _appearance_badness = FixedSpotsCosts::appearance_badness();
+  double _disappearance_badness = FixedSpotsCosts::disappearance_badness();
+  double _absence_badness = FixedSpotsCosts::absence_badness();
+  double _max_speed = FixedSpotsCosts::max_speed();
+  double _max_unseen_distance = FixedSpotsCosts::max_unseen_distance();
+  double _skip_badness = FixedSpotsCosts::skip_badness();
+  double _variance_parameter = FixedSpotsCosts::variance_parameter();
+
+  double appearance_badness() const { return this->_appearance_badness; }
+  double disappearance_badness() const { return this->_disappearance_badness; }
+  double absence_badness() const { return this->_absence_badness; }
+  double max_speed() const { return this->_max_speed; }
+  double max_unseen_distance() const { return this->_max_unseen_distance; }
+  double skip_badness() const { return this->_skip_badness; }
+  double variance_parameter() const { return this->_variance_parameter; }
+};
+
+struct Spot {
+  cv::Point2f center;
+  double weight;
+
+  Spot() {}
+  Spot(cv::Point2f center, double weight) : center(center), weight(weight) {}
+};
+
+// A node of the timeline: either one of the spots of frame num or the
+// ball being absent in that frame
+struct SpotNode {
+  Spot spot;
+  double time;
+  int num;
+  bool present;
+
+  SpotNode(Spot spot, double time, int num, bool present) : spot(spot), time(time), num(num), present(present) {}
+};
+
+template< typename Costs >
+class BasicSpotsTracker {
+public:
+  void push_back(std::vector< Spot > spot, double time);
+  std::tuple< bool, cv::Point2f > front();
+  void pop_front();
+  int get_front_num();
+
+  // Position of the ball in the last frame pushed, as given by the best
+  // path up to it; it only depends on the frames pushed so far, and the
+  // later frames can still change the position given by front()
+  std::tuple< bool, cv::Point2f > back() const;
+
+  // Whether the paths of all the nodes later frames can still jump
+  // from already agree on the front frame, so that it can be committed
+  // without waiting and front() gives the position it would give
+  // later; the last frame pushed is never settled. This relies on the
+  // window not growing in the meantime.
+  bool front_settled();
+
+  // Distribution of the number of frames pushed after each frame before
+  // it was popped
+  int get_latency_percentile(double fraction) const;
+  double get_mean_latency() const;
+
+  // Jump to each frame from the frames of the last window seconds, but
+  // from no more than max_depth frames, so that the work per frame stays
+  // bounded at high frame rates
+  void set_window(double window, int max_depth);
+
+  // Keep only the beam_width spots with the best paths in each frame, as
+  // the only ones later nodes can jump from (0 to keep all of them)
+  void set_beam(int beam_width);
+
+  // Write the frames still in the ring and the commit state to out, and
+  // read them back (leaving the tracker as it was if the stream is not
+  // valid); the window, the beam and the cost model are settings, not
+  // state, and are left as they are
+  void write_state(std::ostream &out) const;
+  bool read_state(std::istream &in);
+
+  // Commit all the frames pushed so far without their positions, as
+  // when their analyses were lost in a restart; the next frame pushed
+  // becomes the front
+  void drop_pending();
+
+  // The grid the spots are bucketed in is sized on the
+  // max_unseen_distance the cost model has at construction
+  Costs cost_model;
+
+  BasicSpotsTracker(Costs cost_model = Costs());
+
+private:
+  static constexpr double INFTY = 1e100;
+
+  int node_num;
+  int front_num;
+  double back_badness;
+  int back_best;
+
+  // The frames live in a ring, frame num in slot (num + 1) %
+  // frame_capacity, as a struct of arrays with room for node_capacity
+  // nodes each. A frame has its spots first, sorted by grid cell, and
+  // then the absent node. Nodes link to their predecessor by frame num
+  // and index; since a frame stays in the ring until dynamic_depth
+  // frames after it is popped, the links of the nodes still in the
+  // timeline can always be followed. The ring only grows when the
+  // timeline gets longer or a frame has more spots than ever before.
+  int frame_capacity;
+  int node_capacity;
+  int oldest_num;
+
+  std::vector< double > frame_time;
+  std::vector< int > frame_spots;
+  // Grid of square cells on the bounding box of the spots
+  std::vector< cv::Point2f > frame_origin;
+  std::vector< int > frame_cols;
+  std::vector< int > frame_rows;
+
+  std::vector< float > node_x;
+  std::vector< float > node_y;
+  std::vector< double > node_weight;
+  std::vector< double > node_badness;
+  std::vector< int > node_cell;
+  // Position of the spot in the vector given to push_back(), to break
+  // ties in the same way whatever the order the nodes are stored in
+  std::vector< int > node_order;
+  std::vector< int > node_prev_num;
+  std::vector< int > node_prev_index;
+
+  // Scratch space of push_back()
+  std::vector< int > sorted_spots;
+  std::vector< double > costs;
+
+  // Count of the popped frames by latency
+  std::vector< long long > latency_counts;
+
+  int dynamic_depth;
+  double dynamic_window;
+  double cell_size;
+  int beam_width;
+
+  int frame_slot(int num) const;
+  int node_slot(int num, int index) const;
+  SpotNode get_node(int num, int index) const;
+  void reserve(int frames, int nodes);
+  template< typename T >
+  static void relayout(std::vector< T > &field, int stride, int new_capacity, int new_stride, int old_capacity, int first, int last);
+  template< typename F >
+  void for_each_run_near(int num, cv::Point2f center, double radius, F f) const;
+
+  // The parts of the costs of the jumps from the nodes of a frame to a
+  // later node that are the same for all the nodes of the frame
+  struct jump_constants_t {
+    // Cost of the jump from any spot, without the distance term
+    double spot_cost;
+    // Whether the locality check and the distance term apply
+    bool distance;
+    double max_distance;
+    double scale;
+    // Cost of the jump from the absent node
+    double absent_cost;
+    bool absent_legal;
+  };
+  jump_constants_t jump_constants(int num, const SpotNode &n2) const;
+  // Writes to costs the badness the node gets by jumping from each of
+  // the spots [first, last) of frame num (INFTY if the jump is not
+  // legal), and returns the minimum
+  double score_spots(int num, int first, int last, cv::Point2f center, const jump_constants_t &c, double *costs) const;
+  std::tuple< bool, cv::Point2f > position_at_front(int num, int index) const;
+  void prune(int num);
+  void _pop_front();
+};
+
+template< typename Costs >
+constexpr double BasicSpotsTracker< Costs >::INFTY;
+
+template< typename Costs >
+BasicSpotsTracker< Costs >::BasicSpotsTracker(Costs cost_model)
+  : cost_model(cost_model),
+    node_num(0),
+    front_num(-1),
+    back_badness(INFTY),
+    back_best(0),
+
+    frame_capacity(0),
+    node_capacity(0),
+    oldest_num(-1),
+
+    dynamic_depth(120),
+    dynamic_window(0.5),
+    cell_size(cost_model.max_unseen_distance() / 2),
+    beam_width(0) {
+
+  // Push a frame with just an absent node; it will be ignored when
+  // returning results
+  this->reserve(2 * this->dynamic_depth + 1, 16);
+  int slot = this->frame_slot(-1);
+  this->frame_time[slot] = 0.0;
+  this->frame_spots[slot] = 0;
+  this->frame_origin[slot] = cv::Point2f(0.0, 0.0);
+  this->frame_cols[slot] = 1;
+  this->frame_rows[slot] = 1;
+  slot = this->node_slot(-1, 0);
+  this->node_x[slot] = 0.0;
+  this->node_y[slot] = 0.0;
+  this->node_weight[slot] = 0.0;
+  this->node_badness[slot] = 0.0;
+  this->node_cell[slot] = 0;
+  this->node_order[slot] = 0;
+  this->node_prev_num[slot] = -2;
+  this->node_prev_index[slot] = 0;
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::set_window(double window, int max_depth) {
+
+  this->dynamic_window = window;
+  this->dynamic_depth = std::max(1, max_depth);
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::set_beam(int beam_width) {
+
+  this->beam_width = beam_width;
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::write_state(std::ostream &out) const {
+
+  write_binary(out, int32_t(this->node_num));
+  write_binary(out, int32_t(this->front_num));
+  write_binary(out, int32_t(this->oldest_num));
+  write_binary(out, int32_t(this->back_best));
+  write_binary(out, this->back_badness);
+  for (int num = this->oldest_num; num < this->node_num; num++) {
+    int slot = this->frame_slot(num);
+    write_binary(out, this->frame_time[slot]);
+    write_binary(out, int32_t(this->frame_spots[slot]));
+    write_binary(out, this->frame_origin[slot].x);
+    write_binary(out, this->frame_origin[slot].y);
+    write_binary(out, int32_t(this->frame_cols[slot]));
+    write_binary(out, int32_t(this->frame_rows[slot]));
+    int base = this->node_slot(num, 0);
+    for (int k = 0; k <= this->frame_spots[slot]; k++) {
+      write_binary(out, this->node_x[base + k]);
+      write_binary(out, this->node_y[base + k]);
+      write_binary(out, this->node_weight[base + k]);
+      write_binary(out, this->node_badness[base + k]);
+      write_binary(out, int32_t(this->node_cell[base + k]));
+      write_binary(out, int32_t(this->node_order[base + k]));
+      write_binary(out, int32_t(this->node_prev_num[base + k]));
+      write_binary(out, int32_t(this->node_prev_index[base + k]));
+    }
+  }
+
+}
+
+template< typename Costs >
+bool BasicSpotsTracker< Costs >::read_state(std::istream &in) {
+
+  int32_t node_num, front_num, oldest_num, back_best;
+  double back_badness;
+  if (!read_binary(in, node_num) || !read_binary(in, front_num) || !read_binary(in, oldest_num) ||
+      !read_binary(in, back_best) || !read_binary(in, back_badness)) return false;
+  // The last frame is always kept, and so are the frames jumped from
+  // by the nodes from the front on
+  if (oldest_num < -1 || oldest_num >= node_num || front_num < oldest_num || front_num > node_num) return false;
+
+  // Fill a new ring, with the same settings, starting from the oldest
+  // frame
+  BasicSpotsTracker tracker(*this);
+  tracker.frame_capacity = 0;
+  tracker.node_capacity = 0;
+  tracker.oldest_num = oldest_num;
+  tracker.node_num = oldest_num;
+  tracker.reserve(std::max(2 * tracker.dynamic_depth + 1, node_num - oldest_num), 16);
+  // Links to the frames before the oldest one cannot be checked (they
+  // are only followed to read the node they point to), but they have to
+  // stay in the ring
+  int max_outside_index = 0;
+  for (int num = oldest_num; num < node_num; num++) {
+    double time;
+    int32_t spots, cols, rows;
+    float origin_x, origin_y;
+    if (!read_binary(in, time) || !read_binary(in, spots) || !read_binary(in, origin_x) || !read_binary(in, origin_y) ||
+        !read_binary(in, cols) || !read_binary(in, rows)) return false;
+    if (spots < 0 || spots > 1 << 20) return false;
+    if (cols < 1 || rows < 1 || int64_t(cols) * rows > 1 << 20) return false;
+    tracker.reserve(num - oldest_num + 1, spots + 1);
+    int slot = tracker.frame_slot(num);
+    tracker.frame_time[slot] = time;
+    tracker.frame_spots[slot] = spots;
+    tracker.frame_origin[slot] = cv::Point2f(origin_x, origin_y);
+    tracker.frame_cols[slot] = cols;
+    tracker.frame_rows[slot] = rows;
+    int base = tracker.node_slot(num, 0);
+    for (int k = 0; k <= spots; k++) {
+      int32_t cell, order, prev_num, prev_index;
+      if (!read_binary(in, tracker.node_x[base + k]) || !read_binary(in, tracker.node_y[base + k]) ||
+          !read_binary(in, tracker.node_weight[base + k]) || !read_binary(in, tracker.node_badness[base + k]) ||
+          !read_binary(in, cell) || !read_binary(in, order) || !read_binary(in, prev_num) || !read_binary(in, prev_index)) return false;
+      // The spots are sorted by cell, then comes the absent node; a
+      // node not reached by any path links to frame -2
+      if (cell < 0 || cell >= cols * rows || (k > 0 && k < spots && cell < tracker.node_cell[base + k - 1])) return false;
+      if (prev_num < -2 || prev_num >= num || prev_index < 0) return false;
+      if (prev_num >= oldest_num) {
+        // Paths are only made of reached nodes, down to the first frame
+        if (prev_index > tracker.frame_spots[tracker.frame_slot(prev_num)]) return false;
+        if (prev_num >= 0 && tracker.node_prev_num[tracker.node_slot(prev_num, prev_index)] == -2) return false;
+      } else {
+        if (prev_index > 1 << 20) return false;
+        max_outside_index = std::max(max_outside_index, int(prev_index));
+      }
+      tracker.node_cell[base + k] = cell;
+      tracker.node_order[base + k] = order;
+      tracker.node_prev_num[base + k] = prev_num;
+      tracker.node_prev_index[base + k] = prev_index;
+    }
+    tracker.node_num++;
+  }
+  tracker.reserve(node_num - oldest_num, max_outside_index + 1);
+  if (back_best < 0 || back_best > tracker.frame_spots[tracker.frame_slot(node_num - 1)]) return false;
+  if (node_num > 0 && tracker.node_prev_num[tracker.node_slot(node_num - 1, back_best)] == -2) return false;
+  tracker.front_num = front_num;
+  tracker.back_best = back_best;
+  tracker.back_badness = back_badness;
+  tracker.latency_counts.clear();
+  *this = std::move(tracker);
+  return true;
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::drop_pending() {
+
+  if (this->node_num == 0) return;
+  this->front_num = this->node_num;
+  this->oldest_num = std::max(this->oldest_num, this->front_num - this->dynamic_depth);
+
+}
+
+template< typename Costs >
+int BasicSpotsTracker< Costs >::frame_slot(int num) const {
+
+  return (num + 1) % this->frame_capacity;
+
+}
+
+template< typename Costs >
+int BasicSpotsTracker< Costs >::node_slot(int num, int index) const {
+
+  return this->frame_slot(num) * this->node_capacity + index;
+
+}
+
+template< typename Costs >
+SpotNode BasicSpotsTracker< Costs >::get_node(int num, int index) const {
+
+  int slot = this->node_slot(num, index);
+  return SpotNode(Spot(cv::Point2f(this->node_x[slot], this->node_y[slot]), this->node_weight[slot]), this->frame_time[this->frame_slot(num)],
+                  num, index < this->frame_spots[this->frame_slot(num)]);
+
+}
+
+// Moves the field from the old layout of the ring to the new one, for
+// the frames from first to last
+template< typename Costs >
+template< typename T >
+void BasicSpotsTracker< Costs >::relayout(std::vector< T > &field, int stride, int new_capacity, int new_stride, int old_capacity, int first, int last) {
+
+  std::vector< T > new_field(new_capacity * new_stride);
+  for (int num = first; num <= last; num++) {
+    int old_slot = (num + 1) % old_capacity;
+    int new_slot = (num + 1) % new_capacity;
+    std::copy(field.begin() + old_slot * stride, field.begin() + (old_slot + 1) * stride, new_field.begin() + new_slot * new_stride);
+  }
+  field.swap(new_field);
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::reserve(int frames, int nodes) {
+
+  if (frames <= this->frame_capacity && nodes <= this->node_capacity) return;
+
+  // Grow geometrically, so that growing is rare
+  int new_frame_capacity = std::max(frames, frames > this->frame_capacity ? 2 * this->frame_capacity : this->frame_capacity);
+  int new_node_capacity = std::max(nodes, nodes > this->node_capacity ? 2 * this->node_capacity : this->node_capacity);
+  int first = this->oldest_num;
+  int last = this->node_num - 1;
+  int fc = this->frame_capacity;
+  int nc = this->node_capacity;
+  if (fc == 0) {
+    // Nothing to move yet
+    fc = 1;
+    last = first - 1;
+  }
+
+  relayout(this->frame_time, 1, new_frame_capacity, 1, fc, first, last);
+  relayout(this->frame_spots, 1, new_frame_capacity, 1, fc, first, last);
+  relayout(this->frame_origin, 1, new_frame_capacity, 1, fc, first, last);
+  relayout(this->frame_cols, 1, new_frame_capacity, 1, fc, first, last);
+  relayout(this->frame_rows, 1, new_frame_capacity, 1, fc, first, last);
+  relayout(this->node_x, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  relayout(this->node_y, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  relayout(this->node_weight, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  relayout(this->node_badness, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  relayout(this->node_cell, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  relayout(this->node_order, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  relayout(this->node_prev_num, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  relayout(this->node_prev_index, nc, new_frame_capacity, new_node_capacity, fc, first, last);
+  this->frame_capacity = new_frame_capacity;
+  this->node_capacity = new_node_capacity;
+  this->costs.resize(new_node_capacity);
+
+}
+
+template< typename Costs >
+template< typename F >
+void BasicSpotsTracker< Costs >::for_each_run_near(int num, cv::Point2f center, double radius, F f) const {
+
+  int slot = this->frame_slot(num);
+  int spots = this->frame_spots[slot];
+  if (spots == 0) return;
+  const cv::Point2f origin = this->frame_origin[slot];
+  int cols = this->frame_cols[slot];
+  int rows = this->frame_rows[slot];
+  double cell_size = cols * rows == 1 ? INFTY : this->cell_size;
+
+  // Be generous with the bounds, the jumps are checked anyway
+  radius *= 1.001;
+  int x0 = std::max(0, int(std::floor((center.x - radius - origin.x) / cell_size)));
+  int x1 = std::min(cols - 1, int(std::floor((center.x + radius - origin.x) / cell_size)));
+  int y0 = std::max(0, int(std::floor((center.y - radius - origin.y) / cell_size)));
+  int y1 = std::min(rows - 1, int(std::floor((center.y + radius - origin.y) / cell_size)));
+  if (x0 > x1 || y0 > y1) return;
+  const int *cells = &this->node_cell[this->node_slot(num, 0)];
+  for (int y = y0; y <= y1; y++) {
+    // The cells of a row are contiguous
+    int first = std::lower_bound(cells, cells + spots, y * cols + x0) - cells;
+    int last = std::lower_bound(cells + first, cells + spots, y * cols + x1 + 1) - cells;
+    if (first < last) f(first, last);
+  }
+
+}
+
+template< typename Costs >
+typename BasicSpotsTracker< Costs >::jump_constants_t BasicSpotsTracker< Costs >::jump_constants(int num, const SpotNode &n2) const {
+
+  jump_constants_t c;
+  double time = n2.time - this->frame_time[this->frame_slot(num)];
+  // Time of the frames skipped by the jump, from this frame to the one
+  // before n2, so that the skips cost the same at any frame rate
+  double skip = this->frame_time[this->frame_slot(n2.num - 1)] - this->frame_time[this->frame_slot(num)];
+  assert(time >= 0);
+  assert(skip >= 0);
+
+  // The terms are added in the order the scalar cost always used, so
+  // that the costs do not change by a rounding
+  const Costs &m = this->cost_model;
+  if (n2.present) {
+    // Present to present, with the locality check and the Gaussian
+    // likelihood of the distance left to score_spots()
+    c.spot_cost = 0.0 - n2.spot.weight + skip * m.skip_badness();
+    c.distance = true;
+    c.max_distance = std::min(m.max_speed() * time, m.max_unseen_distance());
+    c.scale = time * m.variance_parameter();
+    // Absent to present
+    c.absent_cost = 0.0 + m.appearance_badness() - n2.spot.weight + skip * m.skip_badness();
+    c.absent_legal = true;
+  } else {
+    // Present to absent
+    c.spot_cost = 0.0 + m.disappearance_badness() + skip * m.skip_badness();
+    c.distance = false;
+    c.max_distance = INFTY;
+    c.scale = 1.0;
+    // Absent to absent, only from the frame just before
+    c.absent_cost = 0.0 + m.absence_badness() + skip * m.skip_badness();
+    c.absent_legal = num == n2.num - 1;
+  }
+  return c;
+
+}
+
+template< typename Costs >
+double BasicSpotsTracker< Costs >::score_spots(int num, int first, int last, cv::Point2f center, const jump_constants_t &c, double *costs) const {
+
+  int base = this->node_slot(num, 0);
+  const float *xs = &this->node_x[base];
+  const float *ys = &this->node_y[base];
+  const double *badness = &this->node_badness[base];
+  double min_cost = INFTY;
+  int j = first;
+
+#ifdef __AVX2__
+  const __m128 cx = _mm_set1_ps(center.x);
+  const __m128 cy = _mm_set1_ps(center.y);
+  const __m256d spot_cost = _mm256_set1_pd(c.spot_cost);
+  const __m256d max_distance = _mm256_set1_pd(c.max_distance);
+  const __m256d scale = _mm256_set1_pd(c.scale);
+  const __m256d infty = _mm256_set1_pd(INFTY);
+  __m256d min4 = infty;
+  for (; j + 4 <= last; j += 4) {
+    __m256d cost;
+    if (c.distance) {
+      // The differences are taken in single precision, as with Point2f
+      __m256d dx = _mm256_cvtps_pd(_mm_sub_ps(_mm_loadu_ps(xs + j), cx));
+      __m256d dy = _mm256_cvtps_pd(_mm_sub_ps(_mm_loadu_ps(ys + j), cy));
+      __m256d d = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+      cost = _mm256_add_pd(spot_cost, _mm256_div_pd(_mm256_mul_pd(d, d), scale));
+      cost = _mm256_add_pd(_mm256_loadu_pd(badness + j), cost);
+      cost = _mm256_blendv_pd(cost, infty, _mm256_cmp_pd(d, max_distance, _CMP_GT_OQ));
+    } else {
+      cost = _mm256_add_pd(_mm256_loadu_pd(badness + j), spot_cost);
+    }
+    _mm256_storeu_pd(costs + j - first, cost);
+    // A NaN cost is never taken, as with the scalar comparison
+    min4 = _mm256_min_pd(cost, min4);
+  }
+  double mins[4];
+  _mm256_storeu_pd(mins, min4);
+  for (int i = 0; i < 4; i++) {
+    min_cost = std::min(min_cost, mins[i]);
+  }
+#endif
+
+  for (; j < last; j++) {
+    double cost;
+    if (c.distance) {
+      float dx = xs[j] - center.x;
+      float dy = ys[j] - center.y;
+      double d = std::sqrt(double(dx) * dx + double(dy) * dy);
+      cost = badness[j] + (c.spot_cost + d * d / c.scale);
+      if (d > c.max_distance) cost = INFTY;
+    } else {
+      cost = badness[j] + c.spot_cost;
+    }
+    costs[j - first] = cost;
+    if (cost < min_cost) min_cost = cost;
+  }
+
+  return min_cost;
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::push_back(std::vector< Spot > spots, double time) {
+
+  // When first frame is pushed, put its timestamp to the initial
+  // phantom frame (so that time counter does not explode, and the
+  // skipped time is counted from there)
+  if (this->node_num == 0) {
+    this->frame_time[this->frame_slot(-1)] = time;
+  }
+
+  // Make room for the new frame, keeping dynamic_depth frames before
+  // the front
+  int num = this->node_num;
+  int count = spots.size();
+  this->reserve(num - this->oldest_num + 1, count + 1);
+  int slot = this->frame_slot(num);
+  int base = this->node_slot(num, 0);
+  this->frame_time[slot] = time;
+  this->frame_spots[slot] = count;
+
+  // Bucket the spots in a grid; few spots are faster to scan than to
+  // bucket, so they all go in one cell
+  cv::Point2f origin(0.0, 0.0), max_corner(0.0, 0.0);
+  for (int i = 0; i < count; i++) {
+    const cv::Point2f &c = spots[i].center;
+    origin = i == 0 ? c : cv::Point2f(std::min(origin.x, c.x), std::min(origin.y, c.y));
+    max_corner = i == 0 ? c : cv::Point2f(std::max(max_corner.x, c.x), std::max(max_corner.y, c.y));
+  }
+  int cols = 1, rows = 1;
+  if (count >= 16) {
+    cols = int(std::floor((max_corner.x - origin.x) / this->cell_size)) + 1;
+    rows = int(std::floor((max_corner.y - origin.y) / this->cell_size)) + 1;
+  }
+  this->frame_origin[slot] = origin;
+  this->frame_cols[slot] = cols;
+  this->frame_rows[slot] = rows;
+  auto cell = [&](const cv::Point2f &c) {
+    if (cols * rows == 1) return 0;
+    int x = std::min(cols - 1, int(std::floor((c.x - origin.x) / this->cell_size)));
+    int y = std::min(rows - 1, int(std::floor((c.y - origin.y) / this->cell_size)));
+    return y * cols + x;
+  };
+  this->sorted_spots.resize(count);
+  for (int i = 0; i < count; i++) {
+    this->sorted_spots[i] = i;
+  }
+  std::sort(this->sorted_spots.begin(), this->sorted_spots.end(), [&](int a, int b) {
+      return std::make_pair(cell(spots[a].center), a) < std::make_pair(cell(spots[b].center), b);
+    });
+
+  // Fill the nodes, with the absent one last
+  for (int k = 0; k <= count; k++) {
+    bool present = k < count;
+    int i = present ? this->sorted_spots[k] : count;
+    this->node_x[base + k] = present ? spots[i].center.x : 0.0;
+    this->node_y[base + k] = present ? spots[i].center.y : 0.0;
+    this->node_weight[base + k] = present ? spots[i].weight : 0.0;
+    this->node_cell[base + k] = present ? cell(spots[i].center) : 0;
+    this->node_order[base + k] = i;
+    this->node_badness[base + k] = INFTY;
+    this->node_prev_num[base + k] = -2;
+    this->node_prev_index[base + k] = 0;
+  }
+  this->node_num++;
+
+  // Jump from the frames of the last dynamic_window seconds, but from
+  // no more than dynamic_depth frames, and always from the frame just
+  // before, even after a gap. The frames before the front are still in
+  // the ring, so that the jumps do not depend on when the frames are
+  // committed.
+  int begin = std::max(this->oldest_num, num - this->dynamic_depth);
+  while (begin < num - 1 && time - this->frame_time[this->frame_slot(begin)] > this->dynamic_window) {
+    begin++;
+  }
+  this->back_badness = INFTY;
+  int back_order = 0;
+  for (int k = 0; k <= count; k++) {
+    SpotNode n2 = this->get_node(num, k);
+    double &badness = this->node_badness[base + k];
+
+    // Implement a step of the dynamic programming algorithm (with
+    // bounded depth). The result must not depend on the order the
+    // nodes are visited in, so ties go to the earliest frame and then
+    // to the first spot of the frame, as if they were all visited in
+    // the order they were given.
+    int best_order = 0;
+    for (int i = begin; i < num; i++) {
+      int prev_slot = this->frame_slot(i);
+      int prev_base = prev_slot * this->node_capacity;
+      int prev_spots = this->frame_spots[prev_slot];
+      jump_constants_t c = this->jump_constants(i, n2);
+
+      auto relax = [&](int j, double new_badness) {
+        int order = this->node_order[prev_base + j];
+        if (new_badness < badness || (new_badness == badness && this->node_prev_num[base + k] == i && order < best_order)) {
+          badness = new_badness;
+          this->node_prev_num[base + k] = i;
+          this->node_prev_index[base + k] = j;
+          best_order = order;
+        }
+      };
+      // Score the spots [first, last) at once, and then only look at
+      // the ones that reach the minimum
+      auto relax_spots = [&](int first, int last) {
+        double min_cost = this->score_spots(i, first, last, n2.spot.center, c, this->costs.data());
+        if (min_cost == INFTY || min_cost > badness) return;
+        for (int j = first; j < last; j++) {
+          if (this->costs[j - first] == min_cost) relax(j, min_cost);
+        }
+      };
+
+      if (n2.present) {
+        // A present node can only come from the spots within reach and
+        // from the absent node
+        double radius = std::min(this->cost_model.max_unseen_distance(), this->cost_model.max_speed() * (n2.time - this->frame_time[prev_slot]));
+        this->for_each_run_near(i, n2.spot.center, radius, relax_spots);
+      } else {
+        relax_spots(0, prev_spots);
+      }
+      if (c.absent_legal) {
+        relax(prev_spots, this->node_badness[prev_base + prev_spots] + c.absent_cost);
+      }
+    }
+
+    // Update the best position in the back of the queue
+    int order = this->node_order[base + k];
+    if (badness < this->back_badness || (badness == this->back_badness && order < back_order)) {
+      this->back_badness = badness;
+      this->back_best = k;
+      back_order = order;
+    }
+  }
+
+  if (this->beam_width > 0 && count > this->beam_width) {
+    this->prune(num);
+  }
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::prune(int num) {
+
+  // Choose the spots with the best paths, breaking ties as back_best
+  // does, so that back_best is always kept
+  int base = this->node_slot(num, 0);
+  int count = this->frame_spots[this->frame_slot(num)];
+  this->sorted_spots.resize(count);
+  for (int k = 0; k < count; k++) {
+    this->sorted_spots[k] = k;
+  }
+  auto better = [&](int a, int b) {
+    return std::make_pair(this->node_badness[base + a], this->node_order[base + a]) < std::make_pair(this->node_badness[base + b], this->node_order[base + b]);
+  };
+  std::nth_element(this->sorted_spots.begin(), this->sorted_spots.begin() + this->beam_width, this->sorted_spots.end(), better);
+  std::sort(this->sorted_spots.begin(), this->sorted_spots.begin() + this->beam_width);
+
+  // Move them to the front of the frame, keeping them sorted by cell,
+  // and the absent node after them; no later frame links to this one
+  // yet
+  auto move_node = [&](int from, int to) {
+    this->node_x[base + to] = this->node_x[base + from];
+    this->node_y[base + to] = this->node_y[base + from];
+    this->node_weight[base + to] = this->node_weight[base + from];
+    this->node_badness[base + to] = this->node_badness[base + from];
+    this->node_cell[base + to] = this->node_cell[base + from];
+    this->node_order[base + to] = this->node_order[base + from];
+    this->node_prev_num[base + to] = this->node_prev_num[base + from];
+    this->node_prev_index[base + to] = this->node_prev_index[base + from];
+  };
+  int back_best = this->beam_width;
+  for (int k = 0; k < this->beam_width; k++) {
+    int from = this->sorted_spots[k];
+    move_node(from, k);
+    if (from == this->back_best) back_best = k;
+  }
+  move_node(count, this->beam_width);
+  this->back_best = back_best;
+  this->frame_spots[this->frame_slot(num)] = this->beam_width;
+
+}
+
+template< typename Costs >
+std::tuple< bool, cv::Point2f > BasicSpotsTracker< Costs >::position_at_front(int num, int index) const {
+
+  // Go backward until you find the front level
+  while (this->node_prev_num[this->node_slot(num, index)] > this->front_num) {
+    int slot = this->node_slot(num, index);
+    num = this->node_prev_num[slot];
+    index = this->node_prev_index[slot];
+  }
+  int slot = this->node_slot(num, index);
+  SpotNode ret = this->get_node(num, index);
+  SpotNode prev = this->get_node(this->node_prev_num[slot], this->node_prev_index[slot]);
+
+  if (prev.num == this->front_num) {
+    return std::make_tuple(prev.present, prev.spot.center);
+  } else if (ret.num == this->front_num) {
+    return std::make_tuple(ret.present, ret.spot.center);
+  } else {
+    if (ret.present && prev.present) {
+      // Interpolate linearly between the two nodes
+      double t = (this->frame_time[this->frame_slot(this->front_num)] - prev.time) / (ret.time - prev.time);
+      return std::make_tuple(true, cv::Point2f((1 - t) * prev.spot.center + t * ret.spot.center));
+    } else {
+      return std::make_tuple(false, ret.spot.center);
+    }
+  }
+
+}
+
+template< typename Costs >
+std::tuple< bool, cv::Point2f > BasicSpotsTracker< Costs >::front() {
+
+  // Unless the front has number -1; in that case try to pop
+  if (this->front_num == -1) {
+    this->_pop_front();
+  }
+
+  return this->position_at_front(this->node_num - 1, this->back_best);
+
+}
+
+template< typename Costs >
+std::tuple< bool, cv::Point2f > BasicSpotsTracker< Costs >::back() const {
+
+  SpotNode node = this->get_node(this->node_num - 1, this->back_best);
+  return std::make_tuple(node.present, node.spot.center);
+
+}
+
+template< typename Costs >
+bool BasicSpotsTracker< Costs >::front_settled() {
+
+  if (this->node_num == 0) return false;
+  if (this->front_num == -1) {
+    this->_pop_front();
+  }
+
+  // The last frame pushed cannot be committed before the next one
+  int num = this->node_num - 1;
+  if (this->front_num >= num) return false;
+
+  // Later nodes can only jump from the frames in the window of the next
+  // frame (or from later frames, whose paths go through this window
+  // anyway), so the paths of all the nodes there have to give the same
+  // position to the front (or all have the ball absent there). The
+  // window is the one of the next frame as soon as it is pushed, since
+  // the frames after it start their windows later.
+  int begin = std::max(this->oldest_num, this->node_num - this->dynamic_depth);
+  double time = this->frame_time[this->frame_slot(num)];
+  while (begin < num && time - this->frame_time[this->frame_slot(begin)] > this->dynamic_window) {
+    begin++;
+  }
+  bool first = true;
+  bool valid = false;
+  cv::Point2f position;
+  for (int i = begin; i <= num; i++) {
+    int count = this->frame_spots[this->frame_slot(i)];
+    for (int k = 0; k <= count; k++) {
+      // Nodes that no path reaches cannot start one
+      if (this->node_prev_num[this->node_slot(i, k)] < -1) continue;
+      bool other_valid;
+      cv::Point2f other_position;
+      if (i >= this->front_num) {
+        std::tie(other_valid, other_position) = this->position_at_front(i, k);
+      } else if (k == count) {
+        // A jump from an absent node over the front leaves it absent
+        other_valid = false;
+      } else {
+        // A jump from a spot over the front interpolates its position
+        // with a node that is not there yet
+        return false;
+      }
+      if (first) {
+        first = false;
+        valid = other_valid;
+        position = other_position;
+      } else if (other_valid != valid || (valid && other_position != position)) {
+        return false;
+      }
+    }
+  }
+  return true;
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::_pop_front() {
+
+  this->front_num += 1;
+  this->oldest_num = std::max(this->oldest_num, this->front_num - this->dynamic_depth);
+
+  assert(this->front_num < this->node_num);
+
+}
+
+template< typename Costs >
+void BasicSpotsTracker< Costs >::pop_front() {
+
+  if (this->front_num == -1) this->_pop_front();
+  size_t latency = this->node_num - 1 - this->front_num;
+  if (this->latency_counts.size() <= latency) {
+    this->latency_counts.resize(latency + 1, 0);
+  }
+  this->latency_counts[latency]++;
+  this->_pop_front();
+
+}
+
+template< typename Costs >
+int BasicSpotsTracker< Costs >::get_front_num() {
+
+  return this->front_num;
+
+}
+
+template< typename Costs >
+int BasicSpotsTracker< Costs >::get_latency_percentile(double fraction) const {
+
+  long long total = 0;
+  for (long long count : this->latency_counts) {
+    total += count;
+  }
+  long long seen = 0;
+  for (size_t latency = 0; latency < this->latency_counts.size(); latency++) {
+    seen += this->latency_counts[latency];
+    if (seen > 0 && seen >= fraction * total) return latency;
+  }
+  return 0;
+
+}
+
+template< typename Costs >
+double BasicSpotsTracker< Costs >::get_mean_latency() const {
+
+  long long total = 0, sum = 0;
+  for (size_t latency = 0; latency < this->latency_counts.size(); latency++) {
+    total += this->latency_counts[latency];
+    sum += latency * this->latency_counts[latency];
+  }
+  return total > 0 ? double(sum) / total : 0.0;
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef BINARY_IO_HPP_
+#define BINARY_IO_HPP_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Helpers to write the state of the tracker to a binary stream and read
+// it back. Values are stored as they are in memory, so a stream can
+// only be read on the kind of machine that wrote it. The readers return
+// false on a short or malformed stream.
+
+template< typename T >
+inline void write_binary(std::ostream &out, const T &value) {
+
+  static_assert(std::is_trivially_copyable< T >::value, "only plain values can be written as they are");
+  out.write(reinterpret_cast< const char* >(&value), sizeof(T));
+
+}
+
+template< typename T >
+inline bool read_binary(std::istream &in, T &value) {
+
+  static_assert(std::is_trivially_copyable< T >::value, "only plain values can be read as they are");
+  in.read(reinterpret_cast< char* >(&value), sizeof(T));
+  return bool(in);
+
+}
+
+template< typename T >
+inline void write_binary(std::ostream &out, const std::vector< T > &values) {
+
+  static_assert(std::is_trivially_copyable< T >::value, "only plain values can be written as they are");
+  write_binary(out, uint64_t(values.size()));
+  out.write(reinterpret_cast< const char* >(values.data()), values.size() * sizeof(T));
+
+}
+
+template< typename T >
+inline bool read_binary(std::istream &in, std::vector< T > &values) {
+
+  static_assert(std::is_trivially_copyable< T >::value, "only plain values can be read as they are");
+  uint64_t size;
+  // Do not trust a corrupted size to allocate memory
+  if (!read_binary(in, size) || size > (uint64_t(1) << 32) / sizeof(T)) return false;
+  values.resize(size);
+  in.read(reinterpret_cast< char* >(values.data()), size * sizeof(T));
+  return bool(in);
+
+}
+
+// The element type and the size, followed by the pixels row by row
+inline void write_binary(std::ostream &out, const cv::Mat &mat) {
+
+  write_binary(out, int32_t(mat.type()));
+  write_binary(out, int32_t(mat.rows));
+  write_binary(out, int32_t(mat.cols));
+  size_t row_size = mat.cols * mat.elemSize();
+  for (int y = 0; y < mat.rows; y++) {
+    out.write(reinterpret_cast< const char* >(mat.ptr(y)), row_size);
+  }
+
+}
+
+inline bool read_binary(std::istream &in, cv::Mat &mat) {
+
+  int32_t type, rows, cols;
+  if (!read_binary(in, type) || !read_binary(in, rows) || !read_binary(in, cols)) return false;
+  if (type != CV_MAT_TYPE(type) || rows < 0 || cols < 0 || rows > 1 << 16 || cols > 1 << 16) return false;
+  if (rows == 0 || cols == 0) {
+    mat = cv::Mat();
+    return true;
+  }
+  mat.create(rows, cols, type);
+  size_t row_size = mat.cols * mat.elemSize();
+  for (int y = 0; y < mat.rows; y++) {
+    in.read(reinterpret_cast< char* >(mat.ptr(y)), row_size);
+  }
+  return bool(in);
+
+}
+
+#endif
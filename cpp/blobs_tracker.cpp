@@ -30,6 +30,9 @@ BlobsTracker::BlobsTracker(control_panel_t& panel)
     _disappearance_parameter(400.0),
     sigma0(0.03),
     sigma_per_second(1.0),
+    _incremental(true),
+    _popped(0),
+    _relaxed(0),
     panel(panel)
 
 {
@@ -64,6 +67,101 @@ void BlobsTracker::InsertFrameInTimeline(vector<Blob> blobs, int time) {
 }
 
 
+bool BlobsTracker::Transition(const Node &new_node, const Node &old_node, int interval, double &delta_badness, bool debug) {
+	if ( (old_node.is_absent || new_node.is_absent) && interval > 1) {
+		// I nodi assenti non skippano frames
+		return false;
+	}
+
+	delta_badness = (double)(interval-1) * _skip_parameter;
+
+	if ( old_node.is_absent && new_node.is_absent ) {
+		// Transizione da assente ad assente
+		delta_badness += _absent_parameter;
+	}
+
+	if ( old_node.is_absent && !new_node.is_absent ) {
+		// Transizione da assente a presente
+		delta_badness += _appearance_parameter - new_node.blob.weight;
+	}
+
+	if ( !old_node.is_absent && new_node.is_absent ) {
+		// Transizione da presente ad assente
+		delta_badness += _disappearance_parameter;
+	}
+
+
+	if ( !old_node.is_absent && !new_node.is_absent ) {
+		// Transizione da presente a presente
+
+		delta_badness += - new_node.blob.weight;
+
+		if(debug) logger(panel, "ball tracking", DEBUG) << "WEIGHT: " << new_node.blob.weight << endl;
+
+		// Località spaziale
+		Point2f new_center = old_node.blob.center;
+		Point2f old_center = new_node.blob.center;
+		double distance = norm(new_center - old_center);
+
+		// Controllo di località
+		if ( distance > _max_speed / _fps * interval ) return false;
+		if ( distance > _max_unseen_distance ) return false;
+
+		// Verosimiglianza gaussiana
+		double time_diff = interval / _fps;
+		delta_badness += distance * distance / ( time_diff * _variance_parameter );
+
+		if(debug) logger(panel, "ball tracking", DEBUG) << "DELTA BADNESS: " << delta_badness << endl;
+	}
+
+	return true;
+}
+
+void BlobsTracker::RelaxNode(int i, int k, int offset, bool debug) {
+	Node &old_node = _timeline[i][k];
+
+	// Passo base (collegamenti con il nodo fittizio iniziale)
+	if ( old_node.is_absent )
+		old_node.badness = i == 0 ? _disappearance_parameter + offset * _skip_parameter : INFTY;
+	else
+		old_node.badness = (i + offset) * _skip_parameter;
+	old_node.previous = NULL;
+
+	// Programmazione dinamica
+	for (int j=0; j<i; j++) {
+		for (int h=0; h<_timeline[j].size(); h++) {
+
+			Node &new_node = _timeline[j][h];
+
+			double old_badness = new_node.badness;
+			double delta_badness;
+			if ( !Transition(new_node, old_node, i-j, delta_badness, debug) ) continue;
+
+			// Calcolo la nuova badness, e aggiorno se è minore della minima finora trovata
+			double new_badness = old_badness + delta_badness;
+
+			if ( new_badness < old_node.badness ) {
+				old_node.badness = new_badness;
+				// Salvo il percorso ottimo
+				old_node.previous = &new_node;
+			}
+
+		}
+	}
+
+	// Il percorso ottimo parte da un frame ancora nella timeline solo se
+	// il nodo e' raggiungibile
+	if ( old_node.previous != NULL )
+		old_node.root = old_node.previous->root;
+	else
+		old_node.root = old_node.badness < INFTY ? i + offset : -1;
+}
+
+vector<double> BlobsTracker::GetParameters() {
+	return { _fps, _max_speed, _max_unseen_distance, _skip_parameter, _variance_parameter,
+			_absent_parameter, _appearance_parameter, _disappearance_parameter };
+}
+
 vector<Point2f> BlobsTracker::ProcessFrames(int initial_time, int begin_time, int end_time) {
 	logger(panel, "ball tracking", INFO) << "Processing frames from " << begin_time << " to " << end_time-1 << endl;
 	
@@ -73,82 +171,41 @@ vector<Point2f> BlobsTracker::ProcessFrames(int initial_time, int begin_time, in
 	bool verbose = is_loggable(panel, "ball tracking", VERBOSE);
 	bool debug = is_loggable(panel, "ball tracking", DEBUG);
 
+	// In modalita' incrementale le badness sono contate dal primo frame
+	// mai inserito, cosi' che non cambino quando si toglie un frame: i
+	// nodi gia' calcolati vanno ricalcolati solo se il loro percorso
+	// partiva da un frame tolto o passa da un nodo ricalcolato, o se si
+	// fa meglio passando da un nodo la cui badness e' diminuita (solo
+	// l'assenza nel nuovo primo frame e' diventata piu' conveniente)
+	vector<double> parameters = GetParameters();
+	if ( !_incremental || parameters != _relaxed_parameters ) _relaxed = 0;
+	_relaxed_parameters = parameters;
+	int offset = _incremental ? _popped : 0;
+	vector< pair<int, Node*> > decreased;
+
 	for (int i=0; i<_timeline.size(); i++) {
 		for (int k=0; k<_timeline[i].size(); k++) {
 			
 			Node &old_node = _timeline[i][k];
-			
-			// Passo base (collegamenti con il nodo fittizio iniziale)
-			if ( old_node.is_absent )
-				old_node.badness = i == 0 ? _disappearance_parameter : INFTY;
-			else
-				old_node.badness = i * _skip_parameter;
-			old_node.previous = NULL;
-			
-			// Programmazione dinamica
-			for (int j=0; j<i; j++) {
-				for (int h=0; h<_timeline[j].size(); h++) {
-					
-					Node &new_node = _timeline[j][h];
-					
-					double old_badness = new_node.badness;
-					int interval = i-j;
-					
-					if ( (old_node.is_absent || new_node.is_absent) && interval > 1) {
-						// I nodi assenti non skippano frames
-						continue;
-					}
-
-					double delta_badness = (double)(interval-1) * _skip_parameter;
-					
-					if ( old_node.is_absent && new_node.is_absent ) {
-						// Transizione da assente ad assente
-						delta_badness += _absent_parameter;
-					}
-					
-					if ( old_node.is_absent && !new_node.is_absent ) {
-						// Transizione da assente a presente
-						delta_badness += _appearance_parameter - new_node.blob.weight;
-					}
-					
-					if ( !old_node.is_absent && new_node.is_absent ) {
-						// Transizione da presente ad assente
-						delta_badness += _disappearance_parameter;
-					}
-					
-					
-					if ( !old_node.is_absent && !new_node.is_absent ) {
-						// Transizione da presente a presente
-						
-						delta_badness += - new_node.blob.weight;
-
-						if(debug) logger(panel, "ball tracking", DEBUG) << "WEIGHT: " << new_node.blob.weight << endl;
-					
-						// Località spaziale
-						Point2f new_center = old_node.blob.center;
-						Point2f old_center = new_node.blob.center;
-						double distance = norm(new_center - old_center);
-					
-						// Controllo di località
-						if ( distance > _max_speed / _fps * interval ) continue;
-						if ( distance > _max_unseen_distance ) continue;
-					
-						// Verosimiglianza gaussiana
-						double time_diff = interval / _fps;
-						delta_badness += distance * distance / ( time_diff * _variance_parameter );
-
-						if(debug) logger(panel, "ball tracking", DEBUG) << "DELTA BADNESS: " << delta_badness << endl;
-					}
-					
-					// Calcolo la nuova badness, e aggiorno se è minore della minima finora trovata
-					double new_badness = old_badness + delta_badness;
-					
-					if ( new_badness < old_node.badness ) {
-						old_node.badness = new_badness;
-						// Salvo il percorso ottimo
-						old_node.previous = &new_node;
-					}
-					
+
+			bool relax = i >= _relaxed || old_node.root < _popped ||
+					( old_node.previous != NULL && old_node.previous->changed );
+			for (int c=0; !relax && c<decreased.size() && decreased[c].first < i; c++) {
+				double delta_badness;
+				if ( Transition(*decreased[c].second, old_node, i-decreased[c].first, delta_badness, debug) &&
+						decreased[c].second->badness + delta_badness <= old_node.badness ) {
+					relax = true;
+				}
+			}
+
+			old_node.changed = false;
+			if ( relax ) {
+				double old_badness = old_node.badness;
+				Node *old_previous = old_node.previous;
+				RelaxNode(i, k, offset, debug);
+				if ( i < _relaxed ) {
+					old_node.changed = old_node.badness != old_badness || old_node.previous != old_previous;
+					if ( old_node.badness < old_badness ) decreased.push_back(make_pair(i, &old_node));
 				}
 			}
 
@@ -169,6 +226,8 @@ vector<Point2f> BlobsTracker::ProcessFrames(int initial_time, int begin_time, in
 			
 		}
 	}
+	_relaxed = _timeline.size();
+	min_badness -= offset * _skip_parameter;
 	
 	Node *node = best_node;
 	while ( node != NULL && node->previous != NULL ) {
@@ -326,6 +385,8 @@ vector<Point2f> BlobsTracker::ProcessFrames(int initial_time, int begin_time, in
 
 void BlobsTracker::PopFrameFromTimeline() {
 	_timeline.pop_front();
+	_popped++;
+	_relaxed = max(_relaxed - 1, 0);
 }
 
 int BlobsTracker::GetFrontTime() {
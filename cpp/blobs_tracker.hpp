@@ -34,9 +34,11 @@ class Node {
 		Node* previous;
 		Node* next;
 		bool is_absent;	// The ball isn't on the field
+		int root;	// Frame (counted from the first one ever inserted) where the best path starts, -1 if none
+		bool changed;	// The best path changed in the last ProcessFrames()
 		
 		Node(Blob blob, int time, bool is_absent)
-			: blob(blob), badness(INFTY), time(time), previous(NULL), next(NULL), is_absent(is_absent)
+			: blob(blob), badness(INFTY), time(time), previous(NULL), next(NULL), is_absent(is_absent), root(-1), changed(false)
 		{};
 	
 };
@@ -64,9 +66,21 @@ public:
   // smoothing
   double sigma0;
   double sigma_per_second;
+
+  // Keep the dynamic programming across the calls of ProcessFrames(),
+  // relaxing only the new frames and the paths that started in the
+  // popped ones, instead of all the timeline every time
+  bool _incremental;
 private:
   std::deque< std::vector<Node> > _timeline;
+  int _popped; // frames popped so far
+  int _relaxed; // frames at the front of the timeline whose badness is up to date
+  std::vector<double> _relaxed_parameters;
   control_panel_t& panel;
+
+  bool Transition(const Node &new_node, const Node &old_node, int interval, double &delta_badness, bool debug);
+  void RelaxNode(int i, int k, int offset, bool debug);
+  std::vector<double> GetParameters();
 };
 
 #endif
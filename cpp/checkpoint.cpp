@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "checkpoint.hpp"
+#include "binary_io.hpp"
+
+// Bumped whenever the layout changes, so that an old checkpoint is
+// ignored instead of misread
+static const char checkpoint_magic[8] = {'S', 'U', 'B', 'T', 'R', 'K', 'S', 'T'};
+static const int32_t checkpoint_version = 1;
+
+static void write_keypoints(ostream &out, const vector< KeyPoint > &keypoints) {
+
+  write_binary(out, uint64_t(keypoints.size()));
+  for (const KeyPoint &keypoint : keypoints) {
+    write_binary(out, keypoint.pt.x);
+    write_binary(out, keypoint.pt.y);
+    write_binary(out, keypoint.size);
+    write_binary(out, keypoint.angle);
+    write_binary(out, keypoint.response);
+    write_binary(out, int32_t(keypoint.octave));
+    write_binary(out, int32_t(keypoint.class_id));
+  }
+
+}
+
+static bool read_keypoints(istream &in, vector< KeyPoint > &keypoints) {
+
+  uint64_t count;
+  if (!read_binary(in, count) || count > 1 << 20) return false;
+  keypoints.resize(count);
+  for (KeyPoint &keypoint : keypoints) {
+    int32_t octave, class_id;
+    if (!read_binary(in, keypoint.pt.x) || !read_binary(in, keypoint.pt.y) || !read_binary(in, keypoint.size) ||
+        !read_binary(in, keypoint.angle) || !read_binary(in, keypoint.response) || !read_binary(in, octave) ||
+        !read_binary(in, class_id)) return false;
+    keypoint.octave = octave;
+    keypoint.class_id = class_id;
+  }
+  return true;
+
+}
+
+static void write_time(ostream &out, const time_point< system_clock > &time) {
+
+  write_binary(out, int64_t(duration_cast< microseconds >(time.time_since_epoch()).count()));
+
+}
+
+static bool read_time(istream &in, time_point< system_clock > &time) {
+
+  int64_t count;
+  if (!read_binary(in, count)) return false;
+  time = time_point< system_clock >(duration_cast< system_clock::duration >(microseconds(count)));
+  return true;
+
+}
+
+void TrackerState::write(ostream &out) const {
+
+  out.write(checkpoint_magic, sizeof(checkpoint_magic));
+  write_binary(out, checkpoint_version);
+
+  write_binary(out, int32_t(this->reference_size.width));
+  write_binary(out, int32_t(this->reference_size.height));
+  write_binary(out, this->near_transform);
+  write_binary(out, int32_t(this->frames_to_next_detection));
+  write_keypoints(out, this->reference_features);
+
+  write_binary(out, this->mean);
+  write_binary(out, this->variance);
+  write_binary(out, this->corrected_variance);
+  write_binary(out, int32_t(this->corrected_variance_band));
+  write_binary(out, uint8_t(this->median != NULL));
+  if (this->median != NULL) {
+    this->median->write_state(out);
+  }
+
+  write_binary(out, uint64_t(this->spots_timeline.size()));
+  out.write(this->spots_timeline.data(), this->spots_timeline.size());
+  write_binary(out, int32_t(this->next_frame_num));
+  write_time(out, this->first_frame_playback_time);
+  write_time(out, this->last_playback_time);
+
+}
+
+bool TrackerState::read(istream &in) {
+
+  char magic[sizeof(checkpoint_magic)];
+  int32_t version;
+  in.read(magic, sizeof(magic));
+  if (!in || !equal(magic, magic + sizeof(magic), checkpoint_magic)) return false;
+  if (!read_binary(in, version) || version != checkpoint_version) return false;
+
+  int32_t width, height, frames_to_next_detection;
+  if (!read_binary(in, width) || !read_binary(in, height) || !read_binary(in, this->near_transform) ||
+      !read_binary(in, frames_to_next_detection) || !read_keypoints(in, this->reference_features)) return false;
+  this->reference_size = Size(width, height);
+  this->frames_to_next_detection = frames_to_next_detection;
+
+  int32_t corrected_variance_band;
+  uint8_t has_median;
+  if (!read_binary(in, this->mean) || !read_binary(in, this->variance) || !read_binary(in, this->corrected_variance) ||
+      !read_binary(in, corrected_variance_band) || !read_binary(in, has_median)) return false;
+  this->corrected_variance_band = corrected_variance_band;
+  this->median.release();
+  if (has_median) {
+    // The histograms are sized on the mean, as the table frame
+    if (this->mean.empty() || this->mean.total() > 1 << 24) return false;
+    this->median = makePtr< MedianBackground >(this->mean.size());
+    if (!this->median->read_state(in)) return false;
+  }
+
+  uint64_t timeline_size;
+  if (!read_binary(in, timeline_size) || timeline_size > uint64_t(1) << 32) return false;
+  this->spots_timeline.resize(timeline_size);
+  in.read(&this->spots_timeline[0], timeline_size);
+  int32_t next_frame_num;
+  if (!in || !read_binary(in, next_frame_num) || !read_time(in, this->first_frame_playback_time) ||
+      !read_time(in, this->last_playback_time)) return false;
+  this->next_frame_num = next_frame_num;
+  return true;
+
+}
+
+bool save_checkpoint(const TrackerState &state, const string &file_name) {
+
+  string temp_name = file_name + ".tmp";
+  {
+    ofstream out(temp_name, ios::binary | ios::trunc);
+    state.write(out);
+    out.flush();
+    if (!out) return false;
+  }
+  return rename(temp_name.c_str(), file_name.c_str()) == 0;
+
+}
+
+bool load_checkpoint(TrackerState &state, const string &file_name) {
+
+  ifstream in(file_name, ios::binary);
+  return in && state.read(in);
+
+}
@@ -0,0 +1,58 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "median_background.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace chrono;
+
+// The state that the tracker builds up over time and that a restarted
+// tracker would need many seconds to build again: the table fix, the
+// reference features, the background model and the spots timeline. It
+// holds deep copies, so that it can be written while the tracker goes
+// on; the frames not yet output are not part of it.
+class TrackerState {
+
+public:
+
+  // Table fix and reference features, only valid for a reference image
+  // of the same size
+  Size reference_size;
+  Mat near_transform;
+  int frames_to_next_detection = 0;
+  vector< KeyPoint > reference_features;
+
+  // Background model (see TableDescription)
+  Mat mean;
+  Mat variance;
+  Mat corrected_variance;
+  int corrected_variance_band = 0;
+  Ptr< MedianBackground > median;
+
+  // Spots timeline, as written by SpotsTracker::write_state() (empty
+  // when the spots are not tracked), with the number of the next frame
+  // and the times it refers to
+  string spots_timeline;
+  int next_frame_num = 0;
+  time_point< system_clock > first_frame_playback_time;
+  time_point< system_clock > last_playback_time;
+
+  void write(ostream &out) const;
+  bool read(istream &in);
+
+};
+
+// The file is written under a temporary name and then renamed, so that
+// a crash while writing leaves the previous checkpoint in place
+bool save_checkpoint(const TrackerState &state, const string &file_name);
+bool load_checkpoint(TrackerState &state, const string &file_name);
+
+#endif
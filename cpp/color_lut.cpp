@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <cassert>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "color_lut.hpp"
+
+using namespace std;
+using namespace cv;
+
+void ColorLUT::apply_row(const float *in, float *out, int n) const {
+
+  const float *t = this->table.data();
+  const int s1 = side;
+  const int s2 = side * side;
+  int x = 0;
+
+#ifdef __AVX2__
+  const __m256i channel_offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 scale = _mm256_set1_ps(side - 1);
+  const __m256i max_index = _mm256_set1_epi32(side - 2);
+  for (; x + 8 <= n; x += 8) {
+    // Deinterleave the channels of eight pixels and find their cells
+    __m256i index = _mm256_setzero_si256();
+    __m256 frac[3];
+    for (int c = 0; c < 3; c++) {
+      __m256 v = _mm256_i32gather_ps(in + 3 * x + c, channel_offsets, 4);
+      v = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(v, zero), one), scale);
+      __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(v), max_index);
+      frac[c] = _mm256_sub_ps(v, _mm256_cvtepi32_ps(i));
+      index = _mm256_add_epi32(_mm256_slli_epi32(index, bits), i);
+    }
+
+    // Gather the corners and interpolate along each channel in turn
+    __m256 v000 = _mm256_i32gather_ps(t, index, 4);
+    __m256 v001 = _mm256_i32gather_ps(t + 1, index, 4);
+    __m256 v010 = _mm256_i32gather_ps(t + s1, index, 4);
+    __m256 v011 = _mm256_i32gather_ps(t + s1 + 1, index, 4);
+    __m256 v100 = _mm256_i32gather_ps(t + s2, index, 4);
+    __m256 v101 = _mm256_i32gather_ps(t + s2 + 1, index, 4);
+    __m256 v110 = _mm256_i32gather_ps(t + s2 + s1, index, 4);
+    __m256 v111 = _mm256_i32gather_ps(t + s2 + s1 + 1, index, 4);
+    __m256 v00 = _mm256_add_ps(v000, _mm256_mul_ps(frac[2], _mm256_sub_ps(v001, v000)));
+    __m256 v01 = _mm256_add_ps(v010, _mm256_mul_ps(frac[2], _mm256_sub_ps(v011, v010)));
+    __m256 v10 = _mm256_add_ps(v100, _mm256_mul_ps(frac[2], _mm256_sub_ps(v101, v100)));
+    __m256 v11 = _mm256_add_ps(v110, _mm256_mul_ps(frac[2], _mm256_sub_ps(v111, v110)));
+    __m256 v0 = _mm256_add_ps(v00, _mm256_mul_ps(frac[1], _mm256_sub_ps(v01, v00)));
+    __m256 v1 = _mm256_add_ps(v10, _mm256_mul_ps(frac[1], _mm256_sub_ps(v11, v10)));
+    _mm256_storeu_ps(out + x, _mm256_add_ps(v0, _mm256_mul_ps(frac[0], _mm256_sub_ps(v1, v0))));
+  }
+#endif
+
+  for (; x < n; x++) {
+    int index = 0;
+    float frac[3];
+    for (int c = 0; c < 3; c++) {
+      float v = min(max(in[3 * x + c], 0.f), 1.f) * (side - 1);
+      int i = min(int(v), side - 2);
+      frac[c] = v - i;
+      index = (index << bits) + i;
+    }
+    const float *p = t + index;
+    float v00 = p[0] + frac[2] * (p[1] - p[0]);
+    float v01 = p[s1] + frac[2] * (p[s1 + 1] - p[s1]);
+    float v10 = p[s2] + frac[2] * (p[s2 + 1] - p[s2]);
+    float v11 = p[s2 + s1] + frac[2] * (p[s2 + s1 + 1] - p[s2 + s1]);
+    float v0 = v00 + frac[1] * (v01 - v00);
+    float v1 = v10 + frac[1] * (v11 - v10);
+    out[x] = v0 + frac[0] * (v1 - v0);
+  }
+
+}
+
+void ColorLUT::apply(const Mat &frame, Mat &out) const {
+
+  assert(frame.type() == CV_32FC3);
+  out.create(frame.size(), CV_32F);
+  for (int y = 0; y < frame.rows; y++) {
+    this->apply_row(frame.ptr< float >(y), out.ptr< float >(y), frame.cols);
+  }
+
+}
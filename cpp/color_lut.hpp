@@ -0,0 +1,73 @@
+#ifndef COLOR_LUT_HPP_
+#define COLOR_LUT_HPP_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// A per-pixel model that only depends on the color of the pixel (such
+// as the log-likelihood of the ball color), tabulated on a regular
+// side^3 grid over the color cube and read back with trilinear
+// interpolation. Reading the table is a fixed amount of work, however
+// many operations the model takes, and with AVX2 eight pixels are
+// looked up at once with gather instructions.
+class ColorLUT {
+public:
+  static const int bits = 6;
+  static const int side = 1 << bits;
+
+  // f takes a cv::Vec3f color, with channels in frame order and values
+  // in [0, 1], and returns a float
+  template< typename Function >
+  ColorLUT(const Function &f);
+
+  // frame is CV_32FC3 with values in [0, 1] (values outside are
+  // clamped); out is CV_32F, and can be a ROI of a bigger matrix
+  void apply(const cv::Mat &frame, cv::Mat &out) const;
+  void apply_row(const float *in, float *out, int n) const;
+
+private:
+  std::vector< float > table;
+};
+
+// Keeps the table of a model in sync with its parameters: get()
+// rebuilds it only when params differ from the ones it was last built
+// with. Concurrent calls to get() must be serialized by the caller;
+// the returned table can be used freely, even after a rebuild.
+class ColorLUTCache {
+public:
+  template< typename Function >
+  cv::Ptr< const ColorLUT > get(const std::vector< float > &params, const Function &f);
+
+private:
+  std::vector< float > params;
+  cv::Ptr< const ColorLUT > lut;
+};
+
+template< typename Function >
+ColorLUT::ColorLUT(const Function &f) : table(side * side * side) {
+
+  float step = 1.f / (side - 1);
+  float *entry = this->table.data();
+  for (int i0 = 0; i0 < side; i0++) {
+    for (int i1 = 0; i1 < side; i1++) {
+      for (int i2 = 0; i2 < side; i2++) {
+        *entry++ = f(cv::Vec3f(i0 * step, i1 * step, i2 * step));
+      }
+    }
+  }
+
+}
+
+template< typename Function >
+cv::Ptr< const ColorLUT > ColorLUTCache::get(const std::vector< float > &params, const Function &f) {
+
+  if (!this->lut || params != this->params) {
+    this->lut = cv::makePtr< ColorLUT >(f);
+    this->params = params;
+  }
+  return this->lut;
+
+}
+
+#endif /* COLOR_LUT_HPP_ */
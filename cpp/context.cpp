@@ -1,22 +1,29 @@
 
 #include <iomanip>
+#include <sstream>
 
 #include "context.hpp"
 #include "analysis.hpp"
+#include "half_float.hpp"
 #include "staging.hpp"
 #include "subotto_tracking.hpp"
 
 FrameSettings::FrameSettings(const Mat &ref_frame, const Mat &ref_mask)
-  : table_frame_size_alpha(1.0), table_frame_size(reference.metrics.get_ideal_rectangle_size(table_frame_size_alpha)), local_maxima_limit(5), local_maxima_min_distance(0.10f) {
+  : table_frame_size_alpha(1.0), table_frame_size(reference.metrics.get_ideal_rectangle_size(table_frame_size_alpha)), local_maxima_limit(5), local_maxima_min_distance(0.10f), background_model(RUNNING_AVERAGE), compact_background(false), corrected_variance_bands(5) {
 
   this->reference.image = ref_frame;
   this->reference.mask = ref_mask;
+  this->analysis_tiles = choose_analysis_tiles(this->table_frame_size);
+  this->color_luts = makePtr< color_luts_t >();
+  this->classify_pixels = true;
+  this->ball_pyramid_scale = 1;
+  init_foosmen_mask(this->foosmen_stamps, this->table_frame_size, this->table_metrics, this->foosmen_metrics);
 
 }
 
 
 FrameAnalysis::FrameAnalysis(const Mat &frame, int frame_num, const time_point< system_clock > &playback_time, const FrameSettings &frame_settings, control_panel_t &panel)
-  : frame(frame), frame_num(frame_num), playback_time(playback_time), frame_settings(frame_settings), panel(panel), table_tracking_status(frame_settings.table_tracking_params, frame_settings.reference, frame_settings.table_frame_size), table_description(frame_settings.table_frame_size) {
+  : frame(frame), frame_num(frame_num), playback_time(playback_time), frame_settings(frame_settings), panel(panel), table_tracking_status(frame_settings.table_tracking_params, frame_settings.reference, frame_settings.table_frame_size), table_description(frame_settings.table_frame_size, frame_settings.compact_background) {
 
   //logger(this->panel, "gio", DEBUG) << "table_frame_size: " << this->frame_settings.table_frame_size << endl;
 
@@ -34,6 +41,14 @@ void FrameAnalysis::setup_first_table_tracking() {
 
 }
 
+void FrameAnalysis::setup_resumed_table_tracking(const TrackerState &state) {
+
+  this->table_tracking_status.restore_features(state.reference_features);
+  this->table_tracking_status.near_transform = state.near_transform.clone();
+  this->table_tracking_status.frames_to_next_detection = state.frames_to_next_detection;
+
+}
+
 void FrameAnalysis::track_table() {
 
   this->table_transform = ::track_table(this->frame, this->table_tracking_status, this->frame_settings.table_tracking_params, this->panel, this->frame_settings.reference, this->frame_settings.table_metrics, *this);
@@ -42,10 +57,19 @@ void FrameAnalysis::track_table() {
 
 void FrameAnalysis::warp_table_frame() {
 
+	Mat warpTransform = this->table_transform * sizeToUnits(this->frame_settings.table_metrics, this->frame_settings.table_frame_size);
+
+  // The motion gate needs the 8-bit table frame, so the frame is warped
+  // first and converted afterwards
+  if (this->frame_settings.motion_gate.enabled) {
+    warpPerspective(this->frame, this->table_frame_8u, warpTransform, this->frame_settings.table_frame_size, CV_WARP_INVERSE_MAP | CV_INTER_LINEAR);
+    this->table_frame_8u.convertTo(this->table_frame, CV_32F, 1 / 255.f);
+    return;
+  }
+
   Mat frame32f;
   this->frame.convertTo(frame32f, CV_32F, 1 / 255.f);
 
-	Mat warpTransform = this->table_transform * sizeToUnits(this->frame_settings.table_metrics, this->frame_settings.table_frame_size);
 	warpPerspective(frame32f, this->table_frame, warpTransform, this->frame_settings.table_frame_size, CV_WARP_INVERSE_MAP | CV_INTER_LINEAR);
 
 }
@@ -59,18 +83,83 @@ void FrameAnalysis::setup_from_prev_table_analysis(const FrameAnalysis & prev_fr
 void FrameAnalysis::setup_first_table_analysis() {
 
   this->table_description.set_first_frame(this->table_frame);
+  if (this->frame_settings.background_model == RUNNING_MEDIAN) {
+    this->table_description.median = makePtr< MedianBackground >(this->frame_settings.table_frame_size);
+  }
+
+}
+
+void FrameAnalysis::setup_resumed_table_analysis(const TrackerState &state) {
+
+  this->table_description.mean = state.mean.clone();
+  this->table_description.variance = state.variance.clone();
+  this->table_description.correctedVariance = state.corrected_variance.clone();
+  this->table_description.correctedVarianceBand = state.corrected_variance_band;
+  if (state.median != NULL) {
+    this->table_description.median = makePtr< MedianBackground >(*state.median);
+  }
 
 }
 
-void FrameAnalysis::analyze_table() {
+void FrameAnalysis::analyze_table(const FrameAnalysis *prev_frame_analysis) {
 
-  ::do_table_analysis(this->panel, this->table_frame, this->table_description, this->table_analysis);
+  // The unchanged tiles are taken from the previous frame; the ball
+  // plane is only needed in the search window, except by the coarse
+  // ball analysis, which refines its maxima anywhere
+  const MotionTiles *motion = prev_frame_analysis != NULL && !this->motion_tiles.empty() ? &this->motion_tiles : NULL;
+  if (this->frame_settings.classify_pixels) {
+    ::do_classify_pixels(this->panel, this->table_frame, this->table_description, this->ball_description, this->frame_settings.foosmen_params, this->table_analysis, this->pixel_classes, this->frame_settings.analysis_tiles, this->frame_settings.color_luts.get(),
+                         motion, motion != NULL ? &prev_frame_analysis->pixel_classes : NULL,
+                         this->frame_settings.ball_pyramid_scale > 1 ? Rect() : this->ball_window);
+  } else {
+    ::do_table_analysis(this->panel, this->table_frame, this->table_description, this->table_analysis, this->frame_settings.analysis_tiles,
+                        motion, motion != NULL ? &prev_frame_analysis->table_analysis : NULL);
+  }
 
 }
 
-void FrameAnalysis::analyze_ball() {
+void FrameAnalysis::analyze_ball(const FrameAnalysis *prev_frame_analysis) {
 
-  ::do_ball_analysis(this->panel, this->table_frame, this->ball_description, this->table_analysis, this->ball_analysis, this->ball_density);
+  ColorLUTCache *lut = this->frame_settings.color_luts ? &this->frame_settings.color_luts->ball : NULL;
+  if (this->frame_settings.ball_pyramid_scale > 1) {
+    ::do_coarse_ball_analysis(this->panel, this->table_frame, this->ball_description, this->table_analysis, this->ball_analysis, this->ball_density, this->frame_settings.ball_pyramid_scale, lut, this->ball_window);
+  } else {
+    // The previous density is only good for the same search window
+    const MotionTiles *motion = NULL;
+    if (prev_frame_analysis != NULL && !this->motion_tiles.empty() && prev_frame_analysis->ball_window == this->ball_window) {
+      motion = &this->motion_tiles;
+    }
+    ::do_ball_analysis(this->panel, this->table_frame, this->ball_description, this->table_analysis, this->ball_analysis, this->ball_density, this->frame_settings.analysis_tiles, lut, this->frame_settings.classify_pixels ? &this->pixel_classes : NULL, this->ball_window,
+                       motion, motion != NULL ? &prev_frame_analysis->ball_analysis : NULL, motion != NULL ? &prev_frame_analysis->ball_density : NULL);
+  }
+
+}
+
+void FrameAnalysis::reuse_analysis(const FrameAnalysis &prev_frame_analysis) {
+
+  // Nobody writes in the matrices of a frame once it is analyzed, so
+  // they can be shared
+  this->table_analysis = prev_frame_analysis.table_analysis;
+  this->pixel_classes = prev_frame_analysis.pixel_classes;
+  this->ball_analysis = prev_frame_analysis.ball_analysis;
+  this->ball_density = prev_frame_analysis.ball_density;
+  for(int side = 0; side < 2; side++) {
+    for(int bar = 0; bar < BARS; bar++) {
+      this->foosmen_bars_metrics[bar][side] = prev_frame_analysis.foosmen_bars_metrics[bar][side];
+      this->foosmen_bars_analysis[bar][side] = prev_frame_analysis.foosmen_bars_analysis[bar][side];
+      this->bars_shift[bar][side] = prev_frame_analysis.bars_shift[bar][side];
+      this->bars_rot[bar][side] = prev_frame_analysis.bars_rot[bar][side];
+    }
+  }
+  this->idle = true;
+
+  // The background still learns from the frame, so its difference from
+  // the background is taken again; in a new matrix, since the old one
+  // belongs to the previous frame
+  Mat mean;
+  load_map(this->table_description.mean, mean);
+  this->table_analysis.diff = Mat();
+  subtract(this->table_frame, mean, this->table_analysis.diff);
 
 }
 
@@ -87,24 +176,45 @@ void FrameAnalysis::analyze_foosmen() {
                         this->table_analysis,
                         this->bars_shift,
                         this->bars_rot,
-			this->foosmen_mask);
+                        this->frame_settings.color_luts ? this->frame_settings.color_luts->foosmen : NULL,
+                        this->frame_settings.classify_pixels ? &this->pixel_classes : NULL,
+                        this->frame_settings.foosmen_predictions.get());
 
 }
 
 void FrameAnalysis::update_table_description() {
 
-  ::do_update_table_description(this->panel, this->table_frame, this->table_analysis, this->table_description, this->foosmen_mask);
+  ::do_update_table_description(this->panel, this->table_frame, this->table_analysis, this->table_description, &this->foosmen_mask, this->frame_settings.analysis_tiles);
 
 }
 
 void FrameAnalysis::update_corrected_variance() {
 
-  ::do_update_corrected_variance(this->panel, this->table_description);
+  ::do_update_corrected_variance(this->panel, this->table_description, this->frame_settings.corrected_variance_bands);
 
 }
 
 void FrameAnalysis::search_spots() {
 
+  if (this->frame_settings.ball_pyramid_scale > 1) {
+    ::search_spots_coarse_to_fine(this->panel,
+                                  this->ball_density,
+                                  this->frame_settings.ball_pyramid_scale,
+                                  this->table_frame,
+                                  this->ball_description,
+                                  this->table_analysis,
+                                  this->frame_settings.color_luts ? &this->frame_settings.color_luts->ball : NULL,
+                                  this->frame_settings.classify_pixels ? &this->pixel_classes : NULL,
+                                  this->frame_settings.local_maxima_limit,
+                                  this->frame_settings.local_maxima_min_distance,
+                                  this->spots,
+                                  this->frame_settings.table_metrics,
+                                  this->frame_settings.table_frame_size,
+                                  this->frame_num,
+                                  this->ball_window);
+    return;
+  }
+
   ::search_spots(this->panel,
                  this->ball_density,
                  this->frame_settings.local_maxima_limit,
@@ -112,7 +222,8 @@ void FrameAnalysis::search_spots() {
                  this->spots,
                  this->frame_settings.table_metrics,
                  this->frame_settings.table_frame_size,
-                 this->frame_num);
+                 this->frame_num,
+                 this->ball_window);
 
 }
 
@@ -138,12 +249,29 @@ string FrameAnalysis::get_csv_line() {
 
 }
 
+string BallSample::get_csv_line() const {
+
+  stringstream buf;
+  buf << setiosflags(ios::fixed) << setprecision(5);
+  buf << (this->provisional ? "provisional" : "correction") << ",";
+  buf << duration_cast<duration<double>>(this->playback_time.time_since_epoch()).count();
+
+  if (this->is_present) {
+    buf << "," << this->pos_x << "," << this->pos_y;
+  } else {
+    buf << ",,";
+  }
+
+  return buf.str();
+
+}
+
 void FrameAnalysis::draw_ball_display() {
 
   this->table_frame.copyTo(this->ball_display);
   Point2f ball_disp_pos;
-  ball_disp_pos.x = (this->ball_pos_x / this->frame_settings.table_metrics.length + 0.5f) * this->ball_density.cols;
-  ball_disp_pos.y = -(this->ball_pos_y / this->frame_settings.table_metrics.width - 0.5f) * this->ball_density.rows;
+  ball_disp_pos.x = (this->ball_pos_x / this->frame_settings.table_metrics.length + 0.5f) * this->ball_display.cols;
+  ball_disp_pos.y = -(this->ball_pos_y / this->frame_settings.table_metrics.width - 0.5f) * this->ball_display.rows;
   circle(this->ball_display, ball_disp_pos, 8, Scalar(0.0, 1.0, 0.0), 2);
 
 }
@@ -172,19 +300,13 @@ void FrameAnalysis::draw_foosmen_display() {
 
 }
 
-void FrameAnalysis::draw_foosmen_mask() {
+void FrameAnalysis::stamp_foosmen_mask() {
 
+  // The stamps are already in place, only the rods have to be moved
+  this->foosmen_mask = this->frame_settings.foosmen_stamps;
   for(int side = 0; side < 2; side++) {
     for(int bar = 0; bar < BARS; bar++) {
-      float xx = barx(side, bar, this->foosmen_mask.size(), this->frame_settings.table_metrics, this->frame_settings.foosmen_metrics);
-      
-      for(int i = 0; i < this->frame_settings.foosmen_metrics.count[bar]; i++) {
-	float y = (0.5f + i - this->frame_settings.foosmen_metrics.count[bar] * 0.5f) * this->frame_settings.foosmen_metrics.distance[bar];
-	float yy = (0.5f + (y + this->bars_shift[bar][side]) / this->frame_settings.table_metrics.width) * this->foosmen_mask.rows;
-	
-	//line(this->foosmen_mask, Point(xx - 5, yy), Point(xx + 5, yy), Scalar(0.f, 1.f, 0.f));
-	rectangle(this->foosmen_mask, Point(xx - 20, yy - 15), Point(xx + 20, yy + 15), Scalar(.0f, .0f, .0f), CV_FILLED);
-      }
+      this->foosmen_mask.set_shift(side * BARS + bar, this->bars_shift[bar][side] / this->frame_settings.table_metrics.width * this->frame_settings.table_frame_size.height);
     }
   }
 
@@ -203,7 +325,11 @@ void FrameAnalysis::show_all_displays() {
 
   show(this->panel, "frame", "frame", this->frame);
   show(this->panel, "frame", "table_frame", this->table_frame);
-  show(this->panel, "frame", "mean", this->table_description.mean);
+  if (will_show(this->panel, "frame", "mean")) {
+    Mat mean;
+    load_map(this->table_description.mean, mean);
+    show(this->panel, "frame", "mean", mean);
+  }
 
   //show(this->panel, "table detect", "reference image", this->frame_settings.reference.image);
   show(this->panel, "table detect", "reference image with keypoints", this->table_tracking_status.scaled_reference_with_keypoints);
@@ -223,7 +349,11 @@ void FrameAnalysis::show_all_displays() {
     this->draw_foosmen_display();
     show(this->panel, "foosmen tracking", "foosmen", this->foosmen_display);
   }
-  show(this->panel, "foosmen tracking", "foosmen mask", this->foosmen_mask);
+  if (will_show(this->panel, "foosmen tracking", "foosmen mask")) {
+    Mat foosmen_mask;
+    this->foosmen_mask.draw(foosmen_mask, this->table_frame.size());
+    show(this->panel, "foosmen tracking", "foosmen mask", foosmen_mask);
+  }
 
   // Possibly draw ball display
   if (will_show(panel, "ball tracking", "ball")) {
@@ -239,7 +369,7 @@ void FrameAnalysis::show_all_displays() {
 
 
 SubtrackerContext::SubtrackerContext(Mat ref_frame, Mat ref_mask, control_panel_t &panel, bool do_not_track_spots)
-  : last_frame_num(0), frame_settings(ref_frame, ref_mask), panel(panel), spots_tracker(panel), spots_timeline_span(60), do_not_track_spots(do_not_track_spots) {
+  : last_frame_num(0), frame_settings(ref_frame, ref_mask), panel(panel), spots_tracker(panel), spots_timeline_span(60), spots_early_commit(false), spots_ball_stream(false), provisional_frames(0), corrected_frames(0), do_not_track_spots(do_not_track_spots) {
 
 }
 
@@ -249,6 +379,10 @@ void SubtrackerContext::feed(const Mat &frame, time_point< system_clock > playba
   if (!this->first_frame_seen) {
     this->first_frame_seen = true;
     this->first_frame_playback_time = playback_time;
+  } else if (this->resumed_state != NULL && playback_time < this->resumed_state->last_playback_time) {
+    // The clock went back since the state was saved: go on with the
+    // spots timeline as if no time had passed
+    this->first_frame_playback_time += playback_time - this->resumed_state->last_playback_time;
   }
 
   // Create new FrameAnalysis
@@ -264,6 +398,80 @@ void SubtrackerContext::feed(const Mat &frame, time_point< system_clock > playba
 
   // Store FrameAnalysis for next round
   this->prev_frame_analysis = this->frame_analysis;
+  this->resumed_state.release();
+
+}
+
+bool SubtrackerContext::get_state(TrackerState &state) const {
+
+  if (this->prev_frame_analysis == NULL) return false;
+  const FrameAnalysis &last = *this->prev_frame_analysis;
+
+  const table_tracking_status_t &tracking = last.table_tracking_status;
+  state.reference_size = this->frame_settings.reference.image.size();
+  state.near_transform = tracking.near_transform.clone();
+  state.frames_to_next_detection = tracking.frames_to_next_detection;
+  state.reference_features = tracking.reference_features;
+
+  const TableDescription &table = last.table_description;
+  state.mean = table.mean.clone();
+  state.variance = table.variance.clone();
+  state.corrected_variance = table.correctedVariance.clone();
+  state.corrected_variance_band = table.correctedVarianceBand;
+  state.median.release();
+  if (table.median != NULL) {
+    state.median = makePtr< MedianBackground >(*table.median);
+  }
+
+  state.spots_timeline.clear();
+  if (!this->do_not_track_spots) {
+    ostringstream timeline;
+    this->spots_tracker.write_state(timeline);
+    state.spots_timeline = timeline.str();
+  }
+  state.next_frame_num = this->last_frame_num;
+  state.first_frame_playback_time = this->first_frame_playback_time;
+  state.last_playback_time = last.playback_time;
+  return true;
+
+}
+
+void SubtrackerContext::resume(const TrackerState &state) {
+
+  assert(this->prev_frame_analysis == NULL);
+  Ptr< TrackerState > resumed = makePtr< TrackerState >(state);
+
+  // The table fix and the features are only good for the same reference
+  if (state.reference_size != this->frame_settings.reference.image.size() || state.near_transform.empty()) {
+    logger(this->panel, "checkpoint", WARNING) << "The saved table fix is for another reference, detecting the table again" << endl;
+    resumed->near_transform = Mat();
+  }
+
+  // The background has to be of the same size, storage and model
+  TableDescription table(this->frame_settings.table_frame_size, this->frame_settings.compact_background);
+  bool median = this->frame_settings.background_model == RUNNING_MEDIAN;
+  if (state.mean.size() != table.mean.size() || state.mean.type() != table.mean.type() ||
+      state.variance.size() != table.variance.size() || state.variance.type() != table.variance.type() ||
+      state.corrected_variance.size() != table.correctedVariance.size() || state.corrected_variance.type() != table.correctedVariance.type() ||
+      (state.median != NULL) != median) {
+    logger(this->panel, "checkpoint", WARNING) << "The saved background does not fit the current settings, learning it again" << endl;
+    resumed->mean = Mat();
+  }
+
+  // The spots timeline goes on from the frame after the saved ones
+  if (!this->do_not_track_spots && !state.spots_timeline.empty()) {
+    istringstream timeline(state.spots_timeline);
+    if (this->spots_tracker.read_state(timeline)) {
+      this->spots_tracker.drop_pending();
+      this->last_frame_num = state.next_frame_num;
+      this->first_frame_seen = true;
+      this->first_frame_playback_time = state.first_frame_playback_time;
+    } else {
+      logger(this->panel, "checkpoint", WARNING) << "The saved spots timeline is not valid, starting a new one" << endl;
+    }
+  }
+
+  this->resumed_state = resumed;
 
 }
 
@@ -271,6 +479,8 @@ void SubtrackerContext::do_table_tracking() {
 
   if (this->prev_frame_analysis != NULL) {
     this->frame_analysis->setup_from_prev_table_tracking(*this->prev_frame_analysis);
+  } else if (this->resumed_state != NULL && !this->resumed_state->near_transform.empty()) {
+    this->frame_analysis->setup_resumed_table_tracking(*this->resumed_state);
   } else {
     this->frame_analysis->setup_first_table_tracking();
   }
@@ -286,27 +496,55 @@ void SubtrackerContext::do_analysis() {
   // Update running state from previous frame
   if (this->prev_frame_analysis != NULL) {
     this->frame_analysis->setup_from_prev_table_analysis(*this->prev_frame_analysis);
+  } else if (this->resumed_state != NULL && !this->resumed_state->mean.empty()) {
+    this->frame_analysis->setup_resumed_table_analysis(*this->resumed_state);
   } else {
     this->frame_analysis->setup_first_table_analysis();
   }
 
+  // With the motion gate, the analysis of the previous frame is reused
+  // where nothing changed
+  const FrameAnalysis *prev_frame_analysis = NULL;
+  if (this->frame_settings.motion_gate.enabled) {
+    this->frame_analysis->motion_tiles = this->motion_gate.update(this->frame_settings.motion_gate, this->frame_analysis->table_frame_8u);
+    prev_frame_analysis = this->prev_frame_analysis.get();
+    dump_time(this->panel, "cycle", "motion gate");
+    if (is_loggable(this->panel, "motion gate", VERBOSE)) {
+      logger(this->panel, "motion gate", VERBOSE) << "Frame " << this->frame_analysis->frame_num << ": " << this->frame_analysis->motion_tiles.count()
+                                                  << " of " << this->frame_analysis->motion_tiles.total() << " tiles changed" << endl;
+    }
+  }
+
   // Do the actual analysis
-  this->frame_analysis->analyze_table();
-  this->frame_analysis->analyze_ball();
-  this->frame_analysis->analyze_foosmen();
+  this->frame_analysis->ball_window = this->ball_search_window.next_window(this->frame_settings.ball_search, this->frame_settings.table_metrics, this->frame_settings.table_frame_size, this->get_time(*this->frame_analysis));
+  if (prev_frame_analysis != NULL && this->motion_gate.is_idle() && prev_frame_analysis->ball_window == this->frame_analysis->ball_window) {
+    // Nothing moved and the ball is searched in the same place: the
+    // analysis is the one of the previous frame, but the background is
+    // updated as usual
+    this->frame_analysis->reuse_analysis(*prev_frame_analysis);
+  } else {
+    this->frame_analysis->analyze_table(prev_frame_analysis);
+    this->frame_analysis->analyze_ball(prev_frame_analysis);
+    this->frame_analysis->analyze_foosmen();
+  }
 
   // Update the running state
-  this->frame_analysis->draw_foosmen_mask();
+  this->frame_analysis->stamp_foosmen_mask();
   this->frame_analysis->update_table_description();
-  if (this->frame_analysis->frame_num % 5 == 0) {
-    this->frame_analysis->update_corrected_variance();
-  }
+  this->frame_analysis->update_corrected_variance();
 
 }
 
 void SubtrackerContext::do_spot_search() {
 
   this->frame_analysis->search_spots();
+  this->ball_search_window.push_spots(this->frame_settings.ball_search, this->frame_analysis->spots, this->get_time(*this->frame_analysis));
+
+  if (this->frame_settings.ball_search.predict_window && is_loggable(this->panel, "ball tracking", VERBOSE)) {
+    logger(this->panel, "ball tracking", VERBOSE) << "Ball search window " << this->frame_analysis->ball_window
+                                                 << (this->ball_search_window.is_full_scan() ? " (full scan)" : "")
+                                                 << ", searched fraction of pixels so far " << this->ball_search_window.get_searched_fraction() << endl;
+  }
 
 }
 
@@ -318,12 +556,26 @@ void SubtrackerContext::do_spots_tracking() {
   }
 
   // Store the frame in our deque and in the SpotsTracker
-  int frame_num = this->frame_analysis->frame_num;
   this->past_frames.push_back(*this->frame_analysis);
-  this->spots_tracker.push_back(this->frame_analysis->spots, duration_cast< duration< double > >(this->frame_analysis->playback_time - this->first_frame_playback_time).count());
+  this->spots_tracker.push_back(this->frame_analysis->spots, this->get_time(*this->frame_analysis));
 
-  // If we have already filled enough of the past...
-  if (frame_num >= this->spots_timeline_span) {
+  // The best path up to the new frame gives its provisional position
+  if (this->spots_ball_stream) {
+    FrameAnalysis &back = this->past_frames.back();
+    bool valid;
+    Point2f position;
+    tie(valid, position) = this->spots_tracker.back();
+    back.provisional_ball_is_present = valid;
+    back.provisional_ball_pos_x = position.x;
+    back.provisional_ball_pos_y = position.y;
+    this->ball_samples.push_back({back.playback_time, true, valid, position.x, position.y});
+  }
+
+  // Commit the frames once we have filled enough of the past after
+  // them, or before if the tracker already settled on them
+  while (!this->past_frames.empty() &&
+         (this->past_frames.size() > this->spots_timeline_span ||
+          (this->spots_early_commit && this->spots_tracker.front_settled()))) {
     bool valid;
     Point2f position;
     tie(valid, position) = this->spots_tracker.front();
@@ -343,11 +595,26 @@ void SubtrackerContext::do_spots_tracking() {
       frame_analysis.ball_is_present = false;
     }
 
+    if (this->spots_ball_stream) {
+      this->ball_samples.push_back({frame_analysis.playback_time, false, valid, position.x, position.y});
+      this->provisional_frames++;
+      if (frame_analysis.provisional_ball_is_present != valid ||
+          (valid && (frame_analysis.provisional_ball_pos_x != position.x || frame_analysis.provisional_ball_pos_y != position.y))) {
+        this->corrected_frames++;
+      }
+    }
+
     this->ready_frames.push_back(frame_analysis);
   }
 
 }
 
+double SubtrackerContext::get_time(const FrameAnalysis &frame_analysis) const {
+
+  return duration_cast< duration< double > >(frame_analysis.playback_time - this->first_frame_playback_time).count();
+
+}
+
 FrameAnalysis *SubtrackerContext::get_processed_frame() {
 
   if (this->ready_frames.empty()) {
@@ -359,3 +626,15 @@ FrameAnalysis *SubtrackerContext::get_processed_frame() {
   }
 
 }
+
+bool SubtrackerContext::get_ball_sample(BallSample &sample) {
+
+  if (this->ball_samples.empty()) {
+    return false;
+  } else {
+    sample = this->ball_samples.front();
+    this->ball_samples.pop_front();
+    return true;
+  }
+
+}
@@ -10,6 +10,8 @@
 #include "tracking_types.hpp"
 #include "analysis.hpp"
 #include "spots_tracker.hpp"
+#include "staging.hpp"
+#include "checkpoint.hpp"
 
 using namespace std;
 using namespace cv;
@@ -27,6 +29,24 @@ public:
   FoosmenMetrics foosmen_metrics;
   int local_maxima_limit;
   float local_maxima_min_distance;
+  background_model_t background_model;
+  bool compact_background;
+  int corrected_variance_bands;
+  int analysis_tiles;
+  Ptr< color_luts_t > color_luts;
+  // Compute all the per-pixel likelihoods with do_classify_pixels()
+  bool classify_pixels;
+  ball_search_params_t ball_search;
+  // Downscaling of the ball density, whose local maxima are then
+  // refined at full resolution (1 to compute it at full resolution)
+  int ball_pyramid_scale;
+  // When set, the bar shifts are searched around their predictions
+  Ptr< foosmen_predictions_t > foosmen_predictions;
+  // Foosmen stamps excluded from the background update, for null bar
+  // shifts
+  FoosmenMask foosmen_stamps;
+  // Only analyze again the tiles that changed since the previous frame
+  motion_gate_params_t motion_gate;
 
   FrameSettings(const Mat &ref_frame, const Mat &ref_mask);
 
@@ -47,26 +67,39 @@ public:
   table_tracking_status_t table_tracking_status;
   Mat table_transform;
   Mat table_frame;
+  // 8-bit table frame, only with the motion gate
+  Mat table_frame_8u;
   bool feature_matching_used;
   Mat follow_table_before;
   Mat detect_table_matches;
   Mat detect_table_after_matching;
 
+  // Motion gate (empty tiles when disabled); on idle frames searching
+  // the ball in the same window the whole analysis is taken from the
+  // previous frame, and only the background is updated
+  MotionTiles motion_tiles;
+  bool idle = false;
+
   // Table analysis
   TableDescription table_description;
   TableAnalysis table_analysis;
+  PixelClasses pixel_classes;
 
   // Ball analysis
   BallDescription ball_description;
   BallAnalysis ball_analysis;
+  // At the resolution of the table frame divided by ball_pyramid_scale
   Mat ball_density;
+  // Part of the table frame where the ball is searched (empty for all
+  // of it)
+  Rect ball_window;
 
   // Foosmen analysis
   FoosmenBarMetrics foosmen_bars_metrics[BARS][2];
   FoosmenBarAnalysis foosmen_bars_analysis[BARS][2];
   float bars_shift[BARS][2];
   float bars_rot[BARS][2];
-  Mat foosmen_mask;
+  FoosmenMask foosmen_mask;
 
   // Search spots
   vector< Spot > spots;
@@ -74,6 +107,10 @@ public:
   // Final position
   float ball_pos_x, ball_pos_y;
   bool ball_is_present;
+  // Position given by the tracker as soon as the frame was pushed, only
+  // with the ball stream
+  float provisional_ball_pos_x, provisional_ball_pos_y;
+  bool provisional_ball_is_present;
   Mat ball_display;
   Mat foosmen_display;
 
@@ -81,14 +118,17 @@ public:
 
   void setup_from_prev_table_tracking(const FrameAnalysis &prev_frame_analysis);
   void setup_first_table_tracking();
+  void setup_resumed_table_tracking(const TrackerState &state);
   void track_table();
   void warp_table_frame();
 
   void setup_from_prev_table_analysis(const FrameAnalysis & prev_frame_analysis);
   void setup_first_table_analysis();
-  void analyze_table();
-  void analyze_ball();
+  void setup_resumed_table_analysis(const TrackerState &state);
+  void analyze_table(const FrameAnalysis *prev_frame_analysis = NULL);
+  void analyze_ball(const FrameAnalysis *prev_frame_analysis = NULL);
   void analyze_foosmen();
+  void reuse_analysis(const FrameAnalysis &prev_frame_analysis);
   void update_table_description();
   void update_corrected_variance();
 
@@ -97,11 +137,27 @@ public:
   string get_csv_line();
   void draw_ball_display();
   void draw_foosmen_display();
-  void draw_foosmen_mask();
+  void stamp_foosmen_mask();
   void show_all_displays();
 
 };
 
+// A line of the ball stream: the provisional position of the ball in a
+// frame, given as soon as the frame is analyzed, or the final one that
+// corrects it once the frame is committed
+class BallSample {
+
+public:
+
+  time_point< system_clock > playback_time;
+  bool provisional;
+  bool is_present;
+  float pos_x, pos_y;
+
+  string get_csv_line() const;
+
+};
+
 class SubtrackerContext {
 
 public:
@@ -119,19 +175,41 @@ public:
 
   // Spots tracking
   SpotsTracker spots_tracker;
+  // Frames are committed as soon as the tracker settles on them, or at
+  // the latest after spots_timeline_span more frames
   int spots_timeline_span;
+  bool spots_early_commit;
+  // Also queue the provisional and final position of each frame in
+  // ball_samples
+  bool spots_ball_stream;
+  deque< BallSample > ball_samples;
+  int provisional_frames;
+  int corrected_frames;
   bool do_not_track_spots;
+  BallSearchWindow ball_search_window;
+  MotionGate motion_gate;
+  // Taken over by the first frame, instead of starting from scratch
+  Ptr< TrackerState > resumed_state;
 
   SubtrackerContext(Mat ref_frame, Mat ref_mask, control_panel_t &panel, bool do_not_track_spots=false);
 
+  // A copy of the running state, after at least one frame was fed
+  bool get_state(TrackerState &state) const;
+  // Start from a saved state, before feeding any frame; the parts of it
+  // that do not fit the current settings are ignored
+  void resume(const TrackerState &state);
+
   void feed(const Mat &frame, time_point< system_clock > playback_time);
   FrameAnalysis *get_processed_frame();
+  bool get_ball_sample(BallSample &sample);
 
   void do_table_tracking();
   void do_analysis();
   void do_spot_search();
   void do_spots_tracking();
 
+  double get_time(const FrameAnalysis &frame_analysis) const;
+
 };
 
 #endif
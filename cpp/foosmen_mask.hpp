@@ -0,0 +1,108 @@
+#ifndef FOOSMEN_MASK_HPP_
+#define FOOSMEN_MASK_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Sparse mask of the foosmen on the table frame, to keep them out of
+// the background: each rod stamps a rectangle of fixed columns on the
+// rows around each of its foosmen. The stamps are computed once from
+// the metrics, and each frame only sets the shift of the rods, so no
+// full frame mask has to be drawn and scanned to skip the foosmen.
+class FoosmenMask {
+public:
+  // Adds a rod covering the columns [x0, x1]; each foosman covers the
+  // rows [c - half_height, c + half_height], where c is its center (in
+  // rows, for a null shift) plus the shift of the rod, rounded
+  int add_rod(int x0, int x1, const std::vector< float > &centers, int half_height) {
+    rod_t rod;
+    rod.x0 = x0;
+    rod.x1 = x1;
+    rod.centers = centers;
+    rod.half_height = half_height;
+    rod.shift = 0.f;
+    this->rods.push_back(rod);
+    return this->rods.size() - 1;
+  }
+
+  // Shift of the rod, in rows
+  void set_shift(int rod, float shift) {
+    this->rods[rod].shift = shift;
+  }
+
+  int get_rod_count() const {
+    return this->rods.size();
+  }
+
+  // Masked columns of row y, as sorted and disjoint spans [start, end)
+  // inside [0, width)
+  void get_row_spans(int y, int width, std::vector< cv::Range > &spans) const {
+    spans.clear();
+    for (const rod_t &rod : this->rods) {
+      int x0 = std::max(rod.x0, 0);
+      int x1 = std::min(rod.x1 + 1, width);
+      if (x0 >= x1) continue;
+      for (float center : rod.centers) {
+        int c = cvRound(center + rod.shift);
+        if (y >= c - rod.half_height && y <= c + rod.half_height) {
+          spans.push_back(cv::Range(x0, x1));
+          break;
+        }
+      }
+    }
+
+    // Rods can be close enough to overlap
+    std::sort(spans.begin(), spans.end(), [](const cv::Range &a, const cv::Range &b) { return a.start < b.start; });
+    size_t merged = 0;
+    for (size_t i = 0; i < spans.size(); i++) {
+      if (merged > 0 && spans[i].start <= spans[merged - 1].end) {
+        spans[merged - 1].end = std::max(spans[merged - 1].end, spans[i].end);
+      } else {
+        spans[merged++] = spans[i];
+      }
+    }
+    spans.resize(merged);
+  }
+
+  // Calls f(start, end, masked) on the runs of row y that cover
+  // [0, width) in order; spans is scratch space, so that it can be
+  // reused across rows
+  template< typename F >
+  void for_each_run(int y, int width, std::vector< cv::Range > &spans, F f) const {
+    this->get_row_spans(y, width, spans);
+    int x = 0;
+    for (const cv::Range &span : spans) {
+      if (span.start > x) f(x, span.start, false);
+      f(span.start, span.end, true);
+      x = span.end;
+    }
+    if (x < width) f(x, width, false);
+  }
+
+  // Full CV_8UC1 mask (zero on the foosmen), for display
+  void draw(cv::Mat &mask, cv::Size size) const {
+    mask.create(size, CV_8UC1);
+    std::vector< cv::Range > spans;
+    for (int y = 0; y < size.height; y++) {
+      uint8_t *row = mask.ptr< uint8_t >(y);
+      this->for_each_run(y, size.width, spans, [&](int start, int end, bool masked) {
+          std::fill(row + start, row + end, masked ? 0 : 255);
+        });
+    }
+  }
+
+private:
+  struct rod_t {
+    int x0, x1;
+    std::vector< float > centers;
+    int half_height;
+    float shift;
+  };
+
+  std::vector< rod_t > rods;
+};
+
+#endif /* FOOSMEN_MASK_HPP_ */
@@ -0,0 +1,198 @@
+#ifndef HALF_FLOAT_HPP_
+#define HALF_FLOAT_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+#include <opencv2/core/core.hpp>
+
+#if defined(__F16C__) && defined(__AVX__)
+#include <immintrin.h>
+#define HALF_FLOAT_F16C
+#endif
+
+// Half precision (IEEE 754 binary16) storage for the big per-pixel
+// state maps. OpenCV 3 has no 16 bits float type, so compact maps are
+// CV_16U matrices holding the raw bits; kernels convert them one row
+// at a time, with the F16C instructions when the compiler may use
+// them (-march=native does on any recent x86).
+
+inline float half_to_float(uint16_t h) {
+
+#ifdef HALF_FLOAT_F16C
+  return _cvtsh_ss(h);
+#else
+  uint32_t sign = uint32_t(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  uint32_t bits;
+  if (exp == 0x1f) {
+    // Infinity or NaN
+    bits = sign | 0x7f800000 | (mant << 13);
+  } else if (exp != 0) {
+    bits = sign | ((exp + 112) << 23) | (mant << 13);
+  } else if (mant == 0) {
+    bits = sign;
+  } else {
+    // Subnormal half, which is a normal float
+    exp = 113;
+    while (!(mant & 0x400)) {
+      mant <<= 1;
+      exp--;
+    }
+    bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+#endif
+
+}
+
+inline uint16_t float_to_half(float f) {
+
+#ifdef HALF_FLOAT_F16C
+  return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+  // Round to nearest even, like the hardware does
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t float_exp = (bits >> 23) & 0xff;
+  uint32_t mant = bits & 0x7fffff;
+  int exp = int(float_exp) - 127 + 15;
+  if (float_exp == 0xff) return sign | 0x7c00 | (mant ? 0x200 : 0);
+  if (exp >= 0x1f) return sign | 0x7c00;
+  if (exp <= 0) {
+    if (exp < -10) return sign;
+    mant |= 0x800000;
+    int shift = 14 - exp;
+    uint32_t h = mant >> shift;
+    uint32_t rem = mant & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rem > halfway || (rem == halfway && (h & 1))) h++;
+    return sign | h;
+  }
+  uint32_t h = (uint32_t(exp) << 10) | (mant >> 13);
+  uint32_t rem = mant & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+  return sign | h;
+#endif
+
+}
+
+inline void half_to_float(const uint16_t *in, float *out, int n) {
+
+  int i = 0;
+#ifdef HALF_FLOAT_F16C
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (in + i))));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = half_to_float(in[i]);
+  }
+
+}
+
+inline void float_to_half(const float *in, uint16_t *out, int n) {
+
+  int i = 0;
+#ifdef HALF_FLOAT_F16C
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128((__m128i*) (out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = float_to_half(in[i]);
+  }
+
+}
+
+// A state map is either CV_32FC(n) or, when compact, CV_16UC(n) with
+// half floats inside
+
+inline bool is_compact_map(const cv::Mat &map) {
+
+  return map.depth() == CV_16U;
+
+}
+
+inline cv::Mat make_map(cv::Size size, int channels, const cv::Scalar &value, bool compact) {
+
+  if (!compact) {
+    return cv::Mat(size, CV_32FC(channels), value);
+  }
+  cv::Scalar half_value;
+  for (int c = 0; c < channels; c++) {
+    half_value[c] = float_to_half(float(value[c]));
+  }
+  return cv::Mat(size, CV_16UC(channels), half_value);
+
+}
+
+// Row y of a state map as floats: a pointer inside the map itself when
+// it is stored in full precision, otherwise buf, which receives the
+// converted row and must hold cols * channels floats
+inline const float *load_map_row(const cv::Mat &map, int y, float *buf) {
+
+  if (!is_compact_map(map)) {
+    return map.ptr< float >(y);
+  }
+  half_to_float(map.ptr< uint16_t >(y), buf, map.cols * map.channels());
+  return buf;
+
+}
+
+// Same as load_map_row(), but the returned row can be modified and then
+// written back with store_map_row()
+inline float *edit_map_row(cv::Mat &map, int y, float *buf) {
+
+  if (!is_compact_map(map)) {
+    return map.ptr< float >(y);
+  }
+  half_to_float(map.ptr< uint16_t >(y), buf, map.cols * map.channels());
+  return buf;
+
+}
+
+inline void store_map_row(cv::Mat &map, int y, const float *row) {
+
+  int n = map.cols * map.channels();
+  if (is_compact_map(map)) {
+    float_to_half(row, map.ptr< uint16_t >(y), n);
+  } else if (row != map.ptr< float >(y)) {
+    memcpy(map.ptr< float >(y), row, n * sizeof(float));
+  }
+
+}
+
+// Whole map conversions, for the code paths that are not hot enough
+// to deserve a row by row implementation
+inline void load_map(const cv::Mat &map, cv::Mat &out) {
+
+  if (!is_compact_map(map)) {
+    out = map;
+    return;
+  }
+  out.create(map.size(), CV_32FC(map.channels()));
+  for (int y = 0; y < map.rows; y++) {
+    half_to_float(map.ptr< uint16_t >(y), out.ptr< float >(y), map.cols * map.channels());
+  }
+
+}
+
+inline void store_map(const cv::Mat &in, cv::Mat &map, bool compact) {
+
+  if (!compact) {
+    map = in;
+    return;
+  }
+  map.create(in.size(), CV_16UC(in.channels()));
+  for (int y = 0; y < in.rows; y++) {
+    float_to_half(in.ptr< float >(y), map.ptr< uint16_t >(y), in.cols * in.channels());
+  }
+
+}
+
+#endif /* HALF_FLOAT_HPP_ */
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#include "local_maxima.hpp"
+
+using namespace std;
+using namespace cv;
+
+vector< pair< Point, float > > find_top_local_maxima(const Mat &density, int radiusX, int radiusY, int limit) {
+
+  assert(density.type() == CV_32F);
+  vector< pair< Point, float > > res;
+  if (limit <= 0 || density.empty()) return res;
+
+  const int rows = density.rows;
+  const int cols = density.cols;
+  const int bw = radiusX + 1;
+  const int bh = radiusY + 1;
+  const int blockCols = (cols + bw - 1) / bw;
+  const int blockRows = (rows + bh - 1) / bh;
+
+  // Block maxima, in a single pass over the image
+  vector< float > blockMax(blockCols * blockRows, -numeric_limits< float >::infinity());
+  for (int y = 0; y < rows; y++) {
+    const float *row = density.ptr< float >(y);
+    float *bm = &blockMax[(y / bh) * blockCols];
+    for (int bx = 0; bx < blockCols; bx++) {
+      int x1 = min(bx * bw + bw, cols);
+      float m = bm[bx];
+      for (int x = bx * bw; x < x1; x++) {
+        m = max(m, row[x]);
+      }
+      bm[bx] = m;
+    }
+  }
+
+  // Checks the window of (x, y), skipping the blocks that cannot
+  // contain anything bigger than v
+  auto is_local_maximum = [&](int x, int y, float v) {
+    int x0 = max(x - radiusX, 0), x1 = min(x + radiusX + 1, cols);
+    int y0 = max(y - radiusY, 0), y1 = min(y + radiusY + 1, rows);
+    for (int by = y0 / bh; by * bh < y1; by++) {
+      for (int bx = x0 / bw; bx * bw < x1; bx++) {
+        if (blockMax[by * blockCols + bx] <= v) continue;
+        int ya = max(y0, by * bh), yb = min(y1, by * bh + bh);
+        int xa = max(x0, bx * bw), xb = min(x1, bx * bw + bw);
+        for (int yy = ya; yy < yb; yy++) {
+          const float *row = density.ptr< float >(yy);
+          for (int xx = xa; xx < xb; xx++) {
+            if (row[xx] > v) return false;
+          }
+        }
+      }
+    }
+    return true;
+  };
+
+  // Visit the blocks from the highest maximum down; the maxima are
+  // found in non increasing order, so the limit-th one is the
+  // threshold, and blocks that tie with it are still visited
+  vector< int > heap(blockMax.size());
+  for (size_t i = 0; i < heap.size(); i++) {
+    heap[i] = i;
+  }
+  auto lower = [&](int a, int b) { return blockMax[a] < blockMax[b]; };
+  make_heap(heap.begin(), heap.end(), lower);
+  while (!heap.empty()) {
+    int b = heap.front();
+    pop_heap(heap.begin(), heap.end(), lower);
+    heap.pop_back();
+    float m = blockMax[b];
+    if (res.size() >= size_t(limit) && m < res[limit - 1].second) break;
+
+    int bx = b % blockCols, by = b / blockCols;
+    int x1 = min(bx * bw + bw, cols), y1 = min(by * bh + bh, rows);
+    for (int y = by * bh; y < y1; y++) {
+      const float *row = density.ptr< float >(y);
+      for (int x = bx * bw; x < x1; x++) {
+        if (row[x] == m && is_local_maximum(x, y, m)) {
+          res.push_back(make_pair(Point(x, y), m));
+        }
+      }
+    }
+  }
+
+  sort(res.begin(), res.end(), [](const pair< Point, float > &a, const pair< Point, float > &b) {
+    if (a.second != b.second) return a.second > b.second;
+    if (a.first.y != b.first.y) return a.first.y < b.first.y;
+    return a.first.x < b.first.x;
+  });
+  if (res.size() > size_t(limit)) {
+    res.resize(limit);
+  }
+
+  return res;
+
+}
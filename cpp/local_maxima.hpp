@@ -0,0 +1,23 @@
+#ifndef LOCAL_MAXIMA_HPP_
+#define LOCAL_MAXIMA_HPP_
+
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// The (at most) limit highest local maxima of density (CV_32F): the
+// pixels not smaller than any other pixel within radiusX columns and
+// radiusY rows (the same as density >= dilate(density) with a
+// (2 * radiusX + 1) x (2 * radiusY + 1) rectangle). They are sorted by
+// decreasing value, ties broken by row and then by column.
+//
+// The image is split in blocks of (radiusX + 1) x (radiusY + 1)
+// pixels, so that the window of a pixel covers its whole block and a
+// local maximum is always the maximum of its block. Only the block
+// maxima are computed on the whole image; the blocks are then visited
+// from the highest maximum down, and the visit stops as soon as limit
+// local maxima are found and the next block cannot beat the last one.
+std::vector< std::pair< cv::Point, float > > find_top_local_maxima(const cv::Mat &density, int radiusX, int radiusY, int limit);
+
+#endif /* LOCAL_MAXIMA_HPP_ */
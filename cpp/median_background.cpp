@@ -0,0 +1,164 @@
+#include <cassert>
+#include <cstring>
+
+#include "median_background.hpp"
+#include "binary_io.hpp"
+#include "half_float.hpp"
+#include "parallel.hpp"
+
+MedianBackground::MedianBackground(Size size, int decay_interval)
+  : size(size), decay_interval(decay_interval), frame_num(0), cells(size.area() * channels) {
+
+  // Halving keeps the totals below 2 * decay_interval, which must fit
+  // in the 16 bits counters
+  assert(decay_interval > 0 && decay_interval < 32768);
+  memset(this->cells.data(), 0, this->cells.size() * sizeof(cell_t));
+
+}
+
+void MedianBackground::decay_cell(cell_t &cell) {
+
+  // Plain loops on the contiguous histogram, so that the compiler can
+  // vectorize them
+  uint16_t total = 0;
+  uint16_t num_less = 0;
+  for (int l = 0; l < levels; l++) {
+    cell.count[l] >>= 1;
+  }
+  for (int l = 0; l < levels; l++) {
+    total += cell.count[l];
+  }
+  for (int l = 0; l < cell.median; l++) {
+    num_less += cell.count[l];
+  }
+  cell.total = total;
+  cell.num_less = num_less;
+  settle_median(cell);
+
+}
+
+void MedianBackground::push_value(cell_t &cell, float value) {
+
+  int bin = min(max(int(value * 255.f + 0.5f), 0), 255) >> shift;
+  cell.count[bin]++;
+  cell.total++;
+  if (bin < cell.median) cell.num_less++;
+  settle_median(cell);
+
+}
+
+void MedianBackground::settle_median(cell_t &cell) {
+
+  // Move the median until num_less <= total/2 < num_less + count[median]
+  if (cell.total == 0) return;
+  uint16_t half = cell.total / 2;
+  while (cell.num_less > half) {
+    cell.median--;
+    cell.num_less -= cell.count[cell.median];
+  }
+  while (cell.num_less + cell.count[cell.median] <= half) {
+    cell.num_less += cell.count[cell.median];
+    cell.median++;
+  }
+
+}
+
+float MedianBackground::median_value(const cell_t &cell) {
+
+  // Interpolate inside the median bin, as if its samples were evenly
+  // spread
+  float frac = 0.5f;
+  if (cell.count[cell.median] > 0) {
+    frac = (cell.total / 2 - cell.num_less + 0.5f) / cell.count[cell.median];
+  }
+  return (cell.median + frac) * (1 << shift) / 255.f;
+
+}
+
+void MedianBackground::update_row(int y, const float *frame_row, int start, int end, float *median_row) {
+
+  cell_t *row_cells = &this->cells[y * this->size.width * channels];
+  for (int i = start * channels; i < end * channels; i++) {
+    push_value(row_cells[i], frame_row[i]);
+    median_row[i] = median_value(row_cells[i]);
+  }
+
+}
+
+void MedianBackground::update(const Mat &frame, const FoosmenMask *mask, Mat &median) {
+
+  assert(frame.type() == CV_32FC3 && frame.size() == this->size);
+  if (median.empty()) this->get_median(median);
+  assert((median.type() == CV_32FC3 || median.type() == CV_16UC3) && median.size() == this->size);
+
+  this->frame_num++;
+  bool decay = this->frame_num % this->decay_interval == 0;
+
+  // Rows are independent, so they can be updated in parallel
+  parallel_for_range(Range(0, this->size.height), [&](const Range &range) {
+      vector< float > buf(this->size.width * channels);
+      vector< Range > spans;
+      for (int y = range.start; y < range.end; y++) {
+        float *median_row = edit_map_row(median, y, buf.data());
+        // Masked pixels are not updated, but they have to forget like
+        // all the others
+        if (decay) {
+          cell_t *row_cells = &this->cells[y * this->size.width * channels];
+          for (int i = 0; i < this->size.width * channels; i++) {
+            decay_cell(row_cells[i]);
+          }
+        }
+        if (mask != NULL) {
+          mask->for_each_run(y, this->size.width, spans, [&](int start, int end, bool masked) {
+              if (!masked) this->update_row(y, frame.ptr< float >(y), start, end, median_row);
+            });
+        } else {
+          this->update_row(y, frame.ptr< float >(y), 0, this->size.width, median_row);
+        }
+        store_map_row(median, y, median_row);
+      }
+    });
+
+}
+
+void MedianBackground::get_median(Mat &median) const {
+
+  median.create(this->size, CV_32FC3);
+  for (int y = 0; y < this->size.height; y++) {
+    float *median_row = median.ptr< float >(y);
+    const cell_t *row_cells = &this->cells[y * this->size.width * channels];
+    for (int i = 0; i < this->size.width * channels; i++) {
+      median_row[i] = median_value(row_cells[i]);
+    }
+  }
+
+}
+
+int MedianBackground::get_frame_num() const {
+
+  return this->frame_num;
+
+}
+
+void MedianBackground::write_state(ostream &out) const {
+
+  write_binary(out, int32_t(this->size.width));
+  write_binary(out, int32_t(this->size.height));
+  write_binary(out, int32_t(this->decay_interval));
+  write_binary(out, int32_t(this->frame_num));
+  write_binary(out, this->cells);
+
+}
+
+bool MedianBackground::read_state(istream &in) {
+
+  int32_t width, height, decay_interval, frame_num;
+  vector< cell_t > cells;
+  if (!read_binary(in, width) || !read_binary(in, height) || !read_binary(in, decay_interval) || !read_binary(in, frame_num) ||
+      !read_binary(in, cells)) return false;
+  if (Size(width, height) != this->size || decay_interval != this->decay_interval || cells.size() != this->cells.size()) return false;
+  this->frame_num = frame_num;
+  this->cells.swap(cells);
+  return true;
+
+}
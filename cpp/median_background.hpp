@@ -0,0 +1,64 @@
+#ifndef MEDIAN_BACKGROUND_HPP_
+#define MEDIAN_BACKGROUND_HPP_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "foosmen_mask.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Per-pixel running median of the table frame, computed with an
+// incremental histogram of the quantized channel values (this is the
+// old MedianComputer, rearranged to work on the table frame). Each
+// channel of each pixel owns a contiguous cell with its whole
+// histogram, so an update touches a couple of cache lines instead of
+// one line in each of the levels arrays. Old samples are forgotten by
+// halving all the histograms every decay_interval frames.
+class MedianBackground {
+public:
+  static const int channels = 3;
+  static const int shift = 2;
+  static const int levels = 256 >> shift;
+
+  MedianBackground(Size size, int decay_interval = 1024);
+
+  // frame is a CV_32FC3 table frame with values in [0, 1]; pixels
+  // covered by mask (if given) are not updated; median (CV_32FC3, or a
+  // compact CV_16UC3 map) receives the current estimate
+  void update(const Mat &frame, const FoosmenMask *mask, Mat &median);
+  void get_median(Mat &median) const;
+  int get_frame_num() const;
+
+  // Write the histograms to out, and read them back; reading fails,
+  // leaving the background as it was, if they were written for another
+  // size or decay interval
+  void write_state(ostream &out) const;
+  bool read_state(istream &in);
+
+private:
+  struct cell_t {
+    uint16_t count[levels];
+    uint16_t total;
+    uint16_t num_less;
+    uint8_t median;
+  };
+
+  Size size;
+  int decay_interval;
+  int frame_num;
+  vector< cell_t > cells;
+
+  void update_row(int y, const float *frame_row, int start, int end, float *median_row);
+  static void decay_cell(cell_t &cell);
+  static void push_value(cell_t &cell, float value);
+  static void settle_median(cell_t &cell);
+  static float median_value(const cell_t &cell);
+};
+
+#endif /* MEDIAN_BACKGROUND_HPP_ */
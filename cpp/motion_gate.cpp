@@ -0,0 +1,105 @@
+#include <cassert>
+#include <cstdlib>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "motion_gate.hpp"
+#include "parallel.hpp"
+
+vector< Rect > MotionTiles::get_changed_rects() const {
+
+  vector< Rect > rects;
+  for (int ty = 0; ty < this->changed.rows; ty++) {
+    int y0 = ty * this->tile_size;
+    int y1 = min(y0 + this->tile_size, this->size.height);
+    this->for_each_run(y0, [&](int start, int end, bool c) {
+        if (c) rects.push_back(Rect(start, y0, end - start, y1 - y0));
+      });
+  }
+  return rects;
+
+}
+
+const MotionTiles &MotionGate::update(const motion_gate_params_t &params, const Mat &frame) {
+
+  assert(frame.type() == CV_8UC3);
+  int ts = max(params.tile_size, 1);
+  Size grid((frame.cols + ts - 1) / ts, (frame.rows + ts - 1) / ts);
+
+  // A new matrix every time, since the frames keep the tiles they were
+  // analyzed with
+  this->tiles.tile_size = ts;
+  this->tiles.size = frame.size();
+  this->tiles.changed = Mat(grid, CV_8U, Scalar(0));
+
+  bool refresh = this->reference.size() != frame.size() || ++this->frames_since_refresh >= params.refresh_interval;
+  if (refresh) {
+    this->tiles.changed.setTo(1);
+    frame.copyTo(this->reference);
+    this->frames_since_refresh = 0;
+  } else {
+    // Rows of tiles are independent; a tile stops being compared as
+    // soon as it is known to have moved
+    Mat moved(grid, CV_8U, Scalar(0));
+    int n = ts * 3;
+    parallel_for_range(Range(0, grid.height), [&](const Range &range) {
+        for (int ty = range.start; ty < range.end; ty++) {
+          uint8_t *movedRow = moved.ptr< uint8_t >(ty);
+          for (int y = ty * ts; y < min((ty + 1) * ts, frame.rows); y++) {
+            const uint8_t *frameRow = frame.ptr< uint8_t >(y);
+            const uint8_t *refRow = this->reference.ptr< uint8_t >(y);
+            for (int tx = 0; tx < grid.width; tx++) {
+              if (movedRow[tx]) continue;
+              int begin = tx * n;
+              int end = min(begin + n, frame.cols * 3);
+              int diff = 0;
+              for (int i = begin; i < end; i++) {
+                diff = max(diff, abs(int(frameRow[i]) - int(refRow[i])));
+              }
+              movedRow[tx] = diff > params.threshold;
+            }
+          }
+        }
+      });
+
+    int r = (params.halo + ts - 1) / ts;
+    dilate(moved, this->tiles.changed, Mat::ones(2 * r + 1, 2 * r + 1, CV_8U));
+
+    for (const Rect &rect : this->tiles.get_changed_rects()) {
+      Mat dst = this->reference(rect);
+      frame(rect).copyTo(dst);
+    }
+  }
+
+  int count = this->tiles.count();
+  this->frames++;
+  this->idle_frames += count == 0;
+  this->processed_tiles += count;
+  this->total_tiles += this->tiles.total();
+  return this->tiles;
+
+}
+
+bool MotionGate::is_idle() const {
+
+  return !this->tiles.empty() && this->tiles.count() == 0;
+
+}
+
+int MotionGate::get_frames() const {
+
+  return this->frames;
+
+}
+
+int MotionGate::get_idle_frames() const {
+
+  return this->idle_frames;
+
+}
+
+double MotionGate::get_skipped_fraction() const {
+
+  return this->total_tiles > 0 ? 1.0 - double(this->processed_tiles) / this->total_tiles : 0.0;
+
+}
@@ -0,0 +1,101 @@
+#ifndef MOTION_GATE_HPP_
+#define MOTION_GATE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+using namespace std;
+using namespace cv;
+
+struct motion_gate_params_t {
+  bool enabled = false;
+  // Side of the square tiles the table frame is split in, in pixels
+  int tile_size = 16;
+  // A tile has changed when one of its 8-bit channel values moved by
+  // more than this since the tile was last processed
+  int threshold = 12;
+  // The changed tiles are grown by this many pixels, for the filters
+  // that read around the pixels they write
+  int halo = 1;
+  // All the tiles are processed at least once every refresh_interval
+  // frames, so that the slow changes of the background still reach the
+  // analysis
+  int refresh_interval = 50;
+};
+
+// Tiles of the table frame that have to be processed again; the
+// others can take the results of the previous frame
+struct MotionTiles {
+  int tile_size = 0;
+  Size size;
+  Mat changed; // CV_8U, one value per tile, non zero if changed
+
+  bool empty() const {
+    return this->changed.empty();
+  }
+
+  int count() const {
+    return countNonZero(this->changed);
+  }
+
+  int total() const {
+    return this->changed.rows * this->changed.cols;
+  }
+
+  // Whether any tile crossed by the row y of the frame has changed
+  bool row_changed(int y) const {
+    const uint8_t *row = this->changed.ptr< uint8_t >(y / this->tile_size);
+    return std::any_of(row, row + this->changed.cols, [](uint8_t c) { return c != 0; });
+  }
+
+  // Calls f(start, end, changed) on the runs of changed and unchanged
+  // columns that cover the row y of the frame, in order
+  template< typename F >
+  void for_each_run(int y, F f) const {
+    const uint8_t *row = this->changed.ptr< uint8_t >(y / this->tile_size);
+    int tx = 0;
+    while (tx < this->changed.cols) {
+      bool c = row[tx] != 0;
+      int end = tx + 1;
+      while (end < this->changed.cols && (row[end] != 0) == c) end++;
+      f(tx * this->tile_size, std::min(end * this->tile_size, this->size.width), c);
+      tx = end;
+    }
+  }
+
+  // The runs of changed tiles of each row of tiles, in pixels
+  vector< Rect > get_changed_rects() const;
+};
+
+// Cheap frame differencing on the 8-bit table frame: each tile keeps
+// the pixels it had when it was last processed, and is processed again
+// only once they have moved by more than the threshold
+class MotionGate {
+public:
+  // Marks the changed tiles of frame (CV_8UC3), grown by the halo, and
+  // takes their pixels as their new reference
+  const MotionTiles &update(const motion_gate_params_t &params, const Mat &frame);
+
+  // No tile of the last frame has to be processed again
+  bool is_idle() const;
+
+  int get_frames() const;
+  int get_idle_frames() const;
+  // Fraction of the tiles not processed, over all the frames
+  double get_skipped_fraction() const;
+
+private:
+  Mat reference;
+  MotionTiles tiles;
+  int frames_since_refresh = 0;
+
+  int frames = 0;
+  int idle_frames = 0;
+  long long processed_tiles = 0;
+  long long total_tiles = 0;
+};
+
+#endif /* MOTION_GATE_HPP_ */
@@ -0,0 +1,51 @@
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+
+// OpenCV 3.1 does not have the lambda overload of cv::parallel_for_,
+// so we wrap the callable in a ParallelLoopBody by ourselves
+template< typename Function >
+class LambdaLoopBody : public cv::ParallelLoopBody {
+public:
+  LambdaLoopBody(const Function &f) : f(f) {}
+
+  void operator()(const cv::Range &range) const {
+    this->f(range);
+  }
+
+private:
+  Function f;
+};
+
+template< typename Function >
+void parallel_for_range(const cv::Range &range, const Function &f, double nstripes = -1.) {
+
+  cv::parallel_for_(range, LambdaLoopBody< Function >(f), nstripes);
+
+}
+
+// Split rows in tiles horizontal bands and call f on each of them from
+// the thread pool; with a single tile f is called directly on the whole
+// range. All the tiles are done when for_each_tile() returns, so a
+// tiled computation whose stages read a halo around their tile is just
+// a sequence of for_each_tile() calls.
+template< typename Function >
+void for_each_tile(int rows, int tiles, const Function &f) {
+
+  tiles = std::max(1, std::min(tiles, rows));
+  if (tiles == 1) {
+    f(cv::Range(0, rows));
+    return;
+  }
+  parallel_for_range(cv::Range(0, tiles), [&](const cv::Range &range) {
+      for (int t = range.start; t < range.end; t++) {
+        f(cv::Range(t * rows / tiles, (t + 1) * rows / tiles));
+      }
+    }, tiles);
+
+}
+
+#endif /* PARALLEL_HPP_ */
@@ -0,0 +1,151 @@
+#ifndef ROD_PROFILE_HPP_
+#define ROD_PROFILE_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Helpers to find the position of a rod from the 1-D profile of its
+// strip (the likelihood of the foosmen along the rod): each foosman
+// contributes a copy of the profile shifted by its offset, so summing
+// them for every rod shift is a 1-D correlation of the profile with a
+// comb of teeth.
+
+// out[s] = sum over i of profile(s + offsets[i]), for s in [0, n);
+// profile is read with linear interpolation at fractional positions,
+// and a sum that needs samples outside of [0, len - 1] is outside
+inline void comb_correlation(const float *profile, int len, const std::vector< float > &offsets, float outside, float *out, int n) {
+
+  for (int s = 0; s < n; s++) {
+    float sum = 0.f;
+    for (float offset : offsets) {
+      float pos = s + offset;
+      int i = std::floor(pos);
+      float frac = pos - i;
+      if (i < 0 || i > len - 1 || (frac > 0.f && i + 1 > len - 1)) {
+        sum = outside;
+        break;
+      }
+      sum += frac > 0.f ? profile[i] + frac * (profile[i + 1] - profile[i]) : profile[i];
+    }
+    out[s] = sum;
+  }
+
+}
+
+// Subpixel position of the extremum of values at i, from the parabola
+// through it and its two neighbours; the correction is at most half a
+// sample, and none is made at the ends or next to infinite values
+// (such as the outside values of comb_correlation())
+inline float parabolic_peak(const float *values, int n, int i) {
+
+  if (i <= 0 || i >= n - 1) return i;
+  float a = values[i - 1], b = values[i], c = values[i + 1];
+  float den = a - 2.f * b + c;
+  if (den == 0.f || !std::isfinite(den)) return i;
+  float correction = 0.5f * (a - c) / den;
+  return i + std::max(-0.5f, std::min(correction, 0.5f));
+
+}
+
+struct rod_search_params_t {
+  // Search only around the predicted position when the last match was
+  // confident
+  bool predict = false;
+  // Half width of the search window (in samples), on top of the
+  // predicted motion
+  float radius = 4.f;
+  // A match is not confident when it is worse than the one of the last
+  // full search by this fraction of the range of the full correlation;
+  // a shift off by one foosman still matches all but one of them, so
+  // this must stay well below 1 / (number of foosmen)
+  float tolerance = 0.2f;
+  // Smoothing of the velocity estimate
+  float velocity_alpha = 0.5f;
+};
+
+// State of the search of a rod, carried from frame to frame
+struct rod_prediction_t {
+  bool valid = false;
+  int index = 0;          // best shift of the last search
+  float position = 0.f;   // same, with the subpixel correction
+  float velocity = 0.f;   // samples per frame
+  float reference_score = 0.f;
+  float reference_range = 0.f;
+
+  // Statistics
+  long long searched = 0; // shifts evaluated
+  long long total = 0;    // shifts a full search would have evaluated
+  int searches = 0;
+  int fallbacks = 0;      // predicted searches redone in full
+
+  double searched_fraction() const { return total > 0 ? double(searched) / total : 1.0; }
+  double fallback_rate() const { return searches > 0 ? double(fallbacks) / searches : 0.0; }
+};
+
+// Finds the best shift in [0, n) of the comb correlation of profile
+// (the maximum, or the minimum when maximize is false), with the
+// subpixel correction, and updates state with it. With params.predict,
+// when the last match was confident only a window around the position
+// predicted from the velocity is evaluated; if the best shift there is
+// on the border of the window, or much worse than the one of the last
+// full search, the search falls back to all the shifts.
+inline float search_rod_shift(const float *profile, int len, const std::vector< float > &offsets, int n, bool maximize,
+                              const rod_search_params_t &params, rod_prediction_t &state) {
+
+  const float outside = maximize ? -INFINITY : INFINITY;
+  std::vector< float > values(n);
+  std::vector< float > shifted(offsets.size());
+  // Evaluates [lo, hi) and returns the best shift; scores are the
+  // values turned so that higher is better
+  auto evaluate = [&](int lo, int hi) {
+    for (size_t i = 0; i < offsets.size(); i++) {
+      shifted[i] = offsets[i] + lo;
+    }
+    comb_correlation(profile, len, shifted, outside, &values[lo], hi - lo);
+    state.searched += hi - lo;
+    auto best = maximize ? std::max_element(values.begin() + lo, values.begin() + hi) : std::min_element(values.begin() + lo, values.begin() + hi);
+    return int(best - values.begin());
+  };
+  auto score = [&](float v) { return maximize ? v : -v; };
+
+  state.searches++;
+  state.total += n;
+  int best = -1;
+  if (params.predict && state.valid) {
+    float center = state.position + state.velocity;
+    int r = std::ceil(params.radius + std::fabs(state.velocity));
+    int lo = std::max(0, int(std::floor(center)) - r);
+    int hi = std::min(n, int(std::ceil(center)) + r + 1);
+    if (lo < hi) {
+      best = evaluate(lo, hi);
+      bool on_border = (best == lo && lo > 0) || (best == hi - 1 && hi < n);
+      if (on_border || score(values[best]) < state.reference_score - params.tolerance * state.reference_range) {
+        state.fallbacks++;
+        best = -1;
+      }
+    }
+  }
+  if (best < 0) {
+    best = evaluate(0, n);
+    float worst = values[best];
+    for (float v : values) {
+      if (std::isfinite(v) && score(v) < score(worst)) worst = v;
+    }
+    state.reference_score = score(values[best]);
+    state.reference_range = score(values[best]) - score(worst);
+  }
+
+  // A predicted best shift is never on the border of its window, so
+  // its neighbours have been evaluated too
+  float position = parabolic_peak(values.data(), n, best);
+
+  state.velocity = state.valid ? params.velocity_alpha * (position - state.position) + (1.f - params.velocity_alpha) * state.velocity : 0.f;
+  state.valid = std::isfinite(values[best]);
+  state.index = best;
+  state.position = position;
+  return position;
+
+}
+
+#endif /* ROD_PROFILE_HPP_ */
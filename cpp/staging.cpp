@@ -1,11 +1,13 @@
+#include <algorithm>
 #include <deque>
 
 #include "opencv2/imgproc/imgproc.hpp"
 
 #include "spots_tracker.hpp"
 #include "subotto_metrics.hpp"
-#include "staging.hpp"
 #include "analysis.hpp"
+#include "staging.hpp"
+#include "local_maxima.hpp"
 
 using namespace cv;
 using namespace std;
@@ -15,27 +17,8 @@ static vector<pair<Point2f, float>> findLocalMaxima(control_panel_t &panel, Mat
 	typedef pair<Point, float> pi; // point, integer
 	typedef pair<Point2f, float> pf; // point, floating point
 
-	Mat dilatedDensity;
-	dilate(density, dilatedDensity, Mat::ones(2 * radiusY + 1, 2 * radiusX + 1, CV_8U));
-
-	Mat localMaxMask = (density >= dilatedDensity);
-
-	Mat_<Point> nonZero;
-	findNonZero(localMaxMask, nonZero);
-
-	vector<pi> localMaxima;
-	for(int i = 0; i < nonZero.rows; i++) {
-		Point p = *nonZero[i];
-		float w = density.at<float>(p);
-
-		localMaxima.push_back(make_pair(p, w));
-	}
-
-	int count = min(localMaxima.size(), size_t(limit));
-	nth_element(localMaxima.begin(), localMaxima.begin() + count, localMaxima.end(), [](pi a, pi b) {
-		return a.second > b.second;
-	});
-	localMaxima.resize(count);
+	vector<pi> localMaxima = find_top_local_maxima(density, radiusX, radiusY, limit);
+	int count = localMaxima.size();
 
 	vector<pf> results;
 	results.reserve(count);
@@ -58,14 +41,20 @@ void search_spots(control_panel_t &panel,
                   vector< Spot > &spots,
                   const SubottoMetrics &metrics,
                   const Size &tableFrameSize,
-                  int current_time) {
+                  int current_time,
+                  const Rect &window) {
 
 		int radiusX = local_maxima_min_distance / metrics.length * tableFrameSize.width;
 		int radiusY = local_maxima_min_distance / metrics.width * tableFrameSize.height;
 
 		logger(panel, "ball tracking", DEBUG) << "LM radius x: " << radiusX << "LM radius y: " << radiusY << endl;
 
-		auto localMaxima = findLocalMaxima(panel, density, radiusX, radiusY, local_maxima_limit);
+		// Outside the window the density is not meaningful
+		Rect roi = window.area() > 0 ? window & Rect(Point(), density.size()) : Rect(Point(), density.size());
+		auto localMaxima = findLocalMaxima(panel, density(roi), radiusX, radiusY, local_maxima_limit);
+		for (auto &lm : localMaxima) {
+			lm.first += Point2f(roi.tl());
+		}
 
 		dump_time(panel, "cycle", "find local maxima");
 
@@ -89,3 +78,176 @@ void search_spots(control_panel_t &panel,
 			logger(panel, "ball tracking", DEBUG) << "Inserting frame " << current_time << " in timeline" << endl;
 
 }
+
+void search_spots_coarse_to_fine(control_panel_t &panel,
+                                 const Mat &coarseDensity,
+                                 int scale,
+                                 const Mat &tableFrame,
+                                 const BallDescription &ball,
+                                 const TableAnalysis &tableAnalysis,
+                                 ColorLUTCache *lut,
+                                 const PixelClasses *classes,
+                                 int local_maxima_limit,
+                                 float local_maxima_min_distance,
+                                 vector< Spot > &spots,
+                                 const SubottoMetrics &metrics,
+                                 const Size &tableFrameSize,
+                                 int current_time,
+                                 const Rect &window) {
+
+		int radiusX = local_maxima_min_distance / metrics.length * tableFrameSize.width / scale;
+		int radiusY = local_maxima_min_distance / metrics.width * tableFrameSize.height / scale;
+
+		Rect coarseRect(Point(), coarseDensity.size());
+		Rect roi = coarseRect;
+		if (window.area() > 0) {
+			roi = Rect(Point(window.x / scale, window.y / scale),
+			           Point((window.br().x + scale - 1) / scale, (window.br().y + scale - 1) / scale)) & coarseRect;
+		}
+		vector< pair< Point, float > > candidates = find_top_local_maxima(coarseDensity(roi), radiusX, radiusY, local_maxima_limit);
+
+		dump_time(panel, "cycle", "find coarse local maxima");
+
+		// The full resolution maximum is within a coarse pixel from the
+		// candidate; the patch has one more pixel on each side for the
+		// subpixel correction
+		Rect frameRect(Point(), tableFrame.size());
+		for (const auto &candidate : candidates) {
+			Point c = (candidate.first + roi.tl()) * scale;
+			Rect patch = Rect(c.x - scale - 1, c.y - scale - 1, 3 * scale + 2, 3 * scale + 2) & frameRect;
+			Mat density;
+			do_ball_density_patch(tableFrame, ball, tableAnalysis, patch, density, lut, classes);
+
+			Rect inner = Rect(1, 1, density.cols - 2, density.rows - 2) & Rect(Point(), density.size());
+			if (inner.area() == 0) continue;
+			double weight;
+			Point m;
+			minMaxLoc(density(inner), NULL, &weight, NULL, &m);
+			m += inner.tl();
+			Point2f p = subpixelMinimum(panel, -density(Range(m.y, m.y+1), Range(m.x, m.x+1))) + Point2f(m + patch.tl());
+
+			p.x =  (p.x / tableFrame.cols - 0.5f) * metrics.length;
+			p.y = -(p.y / tableFrame.rows - 0.5f) * metrics.width;
+			if (is_loggable(panel, "ball tracking", DEBUG)) {
+				logger(panel, "ball tracking", DEBUG) << "Position (" << p.x << ", " << p.y << ") with weight " << weight << endl;
+			}
+			spots.emplace_back(p, weight);
+		}
+
+		dump_time(panel, "cycle", "refine local maxima");
+
+}
+
+ball_search_params_t::ball_search_params_t()
+  : predict_window(false),
+    max_speed(18.0),
+    margin(0.05),
+    full_scan_interval(30),
+    max_weight_drop(20.0) {
+
+}
+
+BallSearchWindow::BallSearchWindow()
+  : full_scan(true),
+    confident(false),
+    frames_since_full_scan(0),
+    reference_weight(0.0),
+    searched_pixels(0),
+    total_pixels(0) {
+
+}
+
+Rect BallSearchWindow::next_window(const ball_search_params_t &params, const SubottoMetrics &metrics, const Size &tableFrameSize, double time) {
+
+  this->metrics = metrics;
+  this->frame_size = tableFrameSize;
+  Rect frame_rect(Point(), tableFrameSize);
+
+  this->full_scan = !params.predict_window || !this->confident || this->history.empty() || this->frames_since_full_scan >= params.full_scan_interval;
+  if (!this->full_scan) {
+    // Linear prediction from the last two positions, if we have them
+    Point2f predicted = this->history.back().second;
+    double dt = time - this->history.back().first;
+    if (this->history.size() >= 2) {
+      const auto &prev = this->history[this->history.size() - 2];
+      const auto &last = this->history.back();
+      if (last.first > prev.first) {
+        predicted += (last.second - prev.second) * float(dt / (last.first - prev.first));
+      }
+    }
+    float radius = params.max_speed * dt + params.margin;
+
+    // From meters to pixels, as in search_spots()
+    Point2f tl((predicted.x - radius) / metrics.length + 0.5f, 0.5f - (predicted.y + radius) / metrics.width);
+    Point2f br((predicted.x + radius) / metrics.length + 0.5f, 0.5f - (predicted.y - radius) / metrics.width);
+    this->window = Rect(Point(floor(tl.x * tableFrameSize.width), floor(tl.y * tableFrameSize.height)),
+                        Point(ceil(br.x * tableFrameSize.width), ceil(br.y * tableFrameSize.height))) & frame_rect;
+    if (this->window.area() == 0 || this->window == frame_rect) {
+      this->full_scan = true;
+    }
+  }
+  if (this->full_scan) {
+    this->window = frame_rect;
+    this->frames_since_full_scan = 0;
+  } else {
+    this->frames_since_full_scan++;
+  }
+
+  this->searched_pixels += this->window.area();
+  this->total_pixels += frame_rect.area();
+
+  return this->window;
+
+}
+
+void BallSearchWindow::push_spots(const ball_search_params_t &params, const vector< Spot > &spots, double time) {
+
+  if (spots.empty()) {
+    this->confident = false;
+    this->history.clear();
+    return;
+  }
+
+  const Spot &best = *max_element(spots.begin(), spots.end(), [](const Spot &a, const Spot &b) { return a.weight < b.weight; });
+  if (this->full_scan) {
+    this->reference_weight = best.weight;
+  }
+  this->confident = best.weight >= this->reference_weight - params.max_weight_drop;
+
+  // A best spot on the border may be the tail of something outside the
+  // window; the borders of the table frame do not count
+  if (!this->full_scan) {
+    Point2f p((best.center.x / this->metrics.length + 0.5f) * this->frame_size.width,
+              (0.5f - best.center.y / this->metrics.width) * this->frame_size.height);
+    float margin_x = params.margin / this->metrics.length * this->frame_size.width;
+    float margin_y = params.margin / this->metrics.width * this->frame_size.height;
+    if ((this->window.x > 0 && p.x < this->window.x + margin_x) ||
+        (this->window.y > 0 && p.y < this->window.y + margin_y) ||
+        (this->window.br().x < this->frame_size.width && p.x > this->window.br().x - margin_x) ||
+        (this->window.br().y < this->frame_size.height && p.y > this->window.br().y - margin_y)) {
+      this->confident = false;
+    }
+  }
+
+  if (this->confident) {
+    this->history.emplace_back(time, best.center);
+    if (this->history.size() > 2) {
+      this->history.pop_front();
+    }
+  } else {
+    this->history.clear();
+  }
+
+}
+
+double BallSearchWindow::get_searched_fraction() const {
+
+  return this->total_pixels > 0 ? double(this->searched_pixels) / this->total_pixels : 1.0;
+
+}
+
+bool BallSearchWindow::is_full_scan() const {
+
+  return this->full_scan;
+
+}
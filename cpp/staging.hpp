@@ -13,6 +13,77 @@ void search_spots(control_panel_t &panel,
                   vector< Spot > &spots,
                   const SubottoMetrics &metrics,
                   const Size &tableFrameSize,
-                  int current_time);
+                  int current_time,
+                  const Rect &window = Rect());
+
+// search_spots() on the density of do_coarse_ball_analysis(): the
+// local maxima found there are only candidates, and each one is moved
+// to the maximum of the full resolution density in a patch around it
+// (computed with do_ball_density_patch()), which gives the spot
+// position and weight
+void search_spots_coarse_to_fine(control_panel_t &panel,
+                                 const Mat &coarseDensity,
+                                 int scale,
+                                 const Mat &tableFrame,
+                                 const BallDescription &ball,
+                                 const TableAnalysis &tableAnalysis,
+                                 ColorLUTCache *lut,
+                                 const PixelClasses *classes,
+                                 int local_maxima_limit,
+                                 float local_maxima_min_distance,
+                                 vector< Spot > &spots,
+                                 const SubottoMetrics &metrics,
+                                 const Size &tableFrameSize,
+                                 int current_time,
+                                 const Rect &window = Rect());
+
+struct ball_search_params_t {
+  // Search the ball only in a window around its predicted position
+  bool predict_window;
+  // Fastest ball speed (m/s), as in SpotsTracker
+  float max_speed;
+  // Added on each side of the window (m)
+  float margin;
+  // Frames between two full frame scans
+  int full_scan_interval;
+  // Drop of the best spot weight, from the last full scan, after
+  // which the prediction is not trusted any more
+  float max_weight_drop;
+
+  ball_search_params_t();
+};
+
+// Chooses where the ball is searched in each table frame. The position
+// at the next frame is predicted from the best spots of the last two
+// frames, and the window around it is as big as the distance the ball
+// can travel at max_speed since then. The whole frame is scanned every
+// full_scan_interval frames, and whenever the prediction is missing or
+// not confident: no spots, a weak best spot or a best spot on the
+// border of the window.
+class BallSearchWindow {
+public:
+  BallSearchWindow();
+
+  // Window for the table frame at time (in seconds)
+  Rect next_window(const ball_search_params_t &params, const SubottoMetrics &metrics, const Size &tableFrameSize, double time);
+  // Spots found in the last window
+  void push_spots(const ball_search_params_t &params, const vector< Spot > &spots, double time);
+
+  // Fraction of the table frame pixels searched so far
+  double get_searched_fraction() const;
+  bool is_full_scan() const;
+
+private:
+  deque< pair< double, Point2f > > history;
+  SubottoMetrics metrics;
+  Size frame_size;
+  Rect window;
+  bool full_scan;
+  bool confident;
+  int frames_since_full_scan;
+  double reference_weight;
+  long long searched_pixels;
+  long long total_pixels;
+};
 
 #endif /* STAGING_HPP_ */
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <fstream>
+#include <future>
+#include <memory>
 
 #include "control.hpp"
 #include "framereader.hpp"
@@ -90,6 +93,12 @@ bool step_frame = false;
 bool step_on_frame_produced = false;
 bool do_not_track_spots = false;
 int max_frames = -1;
+// Provisional and final ball positions, as soon as they are known
+ofstream ball_stream;
+// Running state saved to resume from after a restart
+string checkpoint_name;
+double checkpoint_interval = 10.0;
+int checkpoints_written = 0;
 
 static void feed_frames(FrameProducer &frame_producer, SubtrackerContext &ctx) {
 
@@ -99,6 +108,9 @@ static void feed_frames(FrameProducer &frame_producer, SubtrackerContext &ctx) {
 
   //VideoWriter video_writer("ball_position.mpg", CV_FOURCC('P','I','M','1'), 100, ctx.frame_settings.table_frame_size, true);
 
+  future< bool > checkpoint_writer;
+  auto next_checkpoint = steady_clock::now() + duration_cast< steady_clock::duration >(duration< double >(checkpoint_interval));
+
   for (int frame_num = 0; max_frames < 0 || frame_num < max_frames; frame_num++) {
 
     dump_time(panel, "cycle", "before GUI");
@@ -133,6 +145,29 @@ static void feed_frames(FrameProducer &frame_producer, SubtrackerContext &ctx) {
     // Feed the frame to the subtracker
     ctx.feed(frame_info.data, frame_info.time);
 
+    // Every now and then copy the running state and write it from
+    // another thread, unless the previous one is still being written
+    if (!checkpoint_name.empty() && steady_clock::now() >= next_checkpoint &&
+        (!checkpoint_writer.valid() || checkpoint_writer.wait_for(seconds(0)) == future_status::ready)) {
+      if (checkpoint_writer.valid() && !checkpoint_writer.get()) {
+        logger(panel, "checkpoint", WARNING) << "Cannot write checkpoint " << checkpoint_name << endl;
+      }
+      auto state = make_shared< TrackerState >();
+      if (ctx.get_state(*state)) {
+        checkpoint_writer = async(launch::async, [state]() { return save_checkpoint(*state, checkpoint_name); });
+        checkpoints_written++;
+        next_checkpoint = steady_clock::now() + duration_cast< steady_clock::duration >(duration< double >(checkpoint_interval));
+      }
+    }
+
+    // Send the ball positions known so far to the ball stream
+    BallSample ball_sample;
+    while (ctx.get_ball_sample(ball_sample)) {
+      if (ball_stream.is_open()) {
+        ball_stream << ball_sample.get_csv_line() << endl;
+      }
+    }
+
     // Obtain as many processed frames as possible
     FrameAnalysis *frameAnalysis;
     while (frameAnalysis = ctx.get_processed_frame()) {
@@ -157,21 +192,84 @@ static void feed_frames(FrameProducer &frame_producer, SubtrackerContext &ctx) {
 
   }
 
+  // Wait for the last checkpoint
+  if (checkpoint_writer.valid() && !checkpoint_writer.get()) {
+    logger(panel, "checkpoint", WARNING) << "Cannot write checkpoint " << checkpoint_name << endl;
+  }
+
 }
 
 int main(int argc, char* argv[]) {
 
+  // Parse options
+  background_model_t background_model = RUNNING_AVERAGE;
+  bool compact_background = false;
+  int analysis_tiles = 0;
+  bool color_lut = true;
+  bool classify_pixels = true;
+  bool ball_window = false;
+  int ball_pyramid_scale = 1;
+  bool predict_rods = false;
+  bool motion_gate = false;
+  bool early_commit = false;
+  string ball_stream_name;
+  int beam_width = 0;
+  double spots_window = 0.5;
+  int spots_depth = 120;
+  bool resume = false;
+  vector< string > args;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--median-background") {
+      background_model = RUNNING_MEDIAN;
+    } else if (arg == "--compact-background") {
+      compact_background = true;
+    } else if (arg == "--no-color-lut") {
+      color_lut = false;
+    } else if (arg == "--no-classify-pixels") {
+      classify_pixels = false;
+    } else if (arg == "--ball-window") {
+      ball_window = true;
+    } else if (arg == "--predict-rods") {
+      predict_rods = true;
+    } else if (arg == "--motion-gate") {
+      motion_gate = true;
+    } else if (arg == "--early-commit") {
+      early_commit = true;
+    } else if (arg == "--ball-stream" && i + 1 < argc) {
+      ball_stream_name = argv[++i];
+    } else if (arg == "--beam" && i + 1 < argc) {
+      beam_width = max(0, atoi(argv[++i]));
+    } else if (arg == "--spots-window" && i + 1 < argc) {
+      spots_window = atof(argv[++i]);
+    } else if (arg == "--spots-depth" && i + 1 < argc) {
+      spots_depth = max(1, atoi(argv[++i]));
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      checkpoint_name = argv[++i];
+    } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+      checkpoint_interval = max(0.0, atof(argv[++i]));
+    } else if (arg == "--resume") {
+      resume = true;
+    } else if (arg == "--tiles" && i + 1 < argc) {
+      analysis_tiles = atoi(argv[++i]);
+    } else if (arg == "--ball-pyramid" && i + 1 < argc) {
+      ball_pyramid_scale = max(1, atoi(argv[++i]));
+    } else {
+      args.push_back(arg);
+    }
+  }
+
   // Parse arguments
   string videoName, referenceImageName, referenceImageMaskName;
-  if (argc == 3 || argc == 4) {
-    videoName = argv[1];
-    referenceImageName = argv[2];
+  if (args.size() == 2 || args.size() == 3) {
+    videoName = args[0];
+    referenceImageName = args[1];
 
-    if(argc == 4) {
-      referenceImageMaskName = argv[3];
+    if(args.size() == 3) {
+      referenceImageMaskName = args[2];
     }
   } else {
-    cerr << "Usage: " << argv[0] << " <video> <reference subotto> [<reference subotto mask>]" << endl;
+    cerr << "Usage: " << argv[0] << " [<options>] <video> <reference subotto> [<reference subotto mask>]" << endl;
     cerr << "<video> can be: " << endl;
     cerr << "\tn (a single digit number) - live capture from video device n" << endl;
     cerr << "\tfilename+ (with a trailing plus) - simulate live capture from video file" << endl;
@@ -180,6 +278,39 @@ int main(int argc, char* argv[]) {
     cerr << "<reference sumotto mask> is an optional B/W image, of the same size," << endl;
     cerr << "\twhere black spots indicate areas of the reference image to hide" << endl;
     cerr << "\twhen looking for the table (such as moving parts and spurious features)" << endl;
+    cerr << "<options> can be: " << endl;
+    cerr << "\t--median-background - estimate the table background with a running median" << endl;
+    cerr << "\tinstead of a running average (slower, but robust to objects standing still)" << endl;
+    cerr << "\t--compact-background - store the corrected variance map as half floats" << endl;
+    cerr << "\t--tiles <n> - split the table frame analysis in n tiles processed in" << endl;
+    cerr << "\tparallel (by default the number is chosen from the table frame size)" << endl;
+    cerr << "\t--no-color-lut - compute the ball and foosmen color models on each pixel" << endl;
+    cerr << "\tinstead of reading them from precomputed tables" << endl;
+    cerr << "\t--no-classify-pixels - compute the ball and foosmen color models in" << endl;
+    cerr << "\ttheir own analysis stages instead of in one pass with the table one" << endl;
+    cerr << "\t--ball-window - search the ball only around its predicted position," << endl;
+    cerr << "\twith a periodic full frame scan" << endl;
+    cerr << "\t--ball-pyramid <scale> - compute the ball density at 1/scale of the" << endl;
+    cerr << "\ttable frame resolution and refine its maxima at full resolution" << endl;
+    cerr << "\t--predict-rods - search each rod only around the shift predicted" << endl;
+    cerr << "\tfrom its velocity, unless the match there is poor" << endl;
+    cerr << "\t--motion-gate - analyze again only the parts of the table frame that" << endl;
+    cerr << "\tchanged since the previous frame, and skip the frames where nothing did" << endl;
+    cerr << "\t--early-commit - output each frame as soon as all the ball tracks" << endl;
+    cerr << "\tagree on it, instead of always waiting for the following ones" << endl;
+    cerr << "\t--ball-stream <file> - also write to file the ball position of each" << endl;
+    cerr << "\tframe as soon as it is analyzed, tagged as provisional, and then the" << endl;
+    cerr << "\tfinal one, tagged as correction, when the frame is output" << endl;
+    cerr << "\t--beam <width> - track the ball only through the width best spots of" << endl;
+    cerr << "\teach frame, in bounded time per frame" << endl;
+    cerr << "\t--spots-window <seconds> - track the ball through the frames of the last" << endl;
+    cerr << "\tseconds (0.5 by default), but through no more than the depth" << endl;
+    cerr << "\t--spots-depth <frames> - at most that many frames (120 by default)" << endl;
+    cerr << "\t--checkpoint <file> - save to file the table fix, the background and the" << endl;
+    cerr << "\tball timeline every few seconds, to resume from after a restart" << endl;
+    cerr << "\t--checkpoint-interval <seconds> - save the checkpoint every that many" << endl;
+    cerr << "\tseconds (10 by default)" << endl;
+    cerr << "\t--resume - start from the checkpoint file, if there is a valid one" << endl;
     return 1;
   }
 
@@ -194,11 +325,46 @@ int main(int argc, char* argv[]) {
   }
 
   SubtrackerContext ctx(ref_frame, ref_mask, panel, do_not_track_spots);
+  ctx.frame_settings.background_model = background_model;
+  ctx.frame_settings.compact_background = compact_background;
+  if (analysis_tiles > 0) {
+    ctx.frame_settings.analysis_tiles = analysis_tiles;
+  }
+  if (!color_lut) {
+    ctx.frame_settings.color_luts.release();
+  }
+  ctx.frame_settings.classify_pixels = classify_pixels;
+  ctx.frame_settings.ball_search.predict_window = ball_window;
+  ctx.frame_settings.ball_pyramid_scale = ball_pyramid_scale;
+  if (predict_rods) {
+    ctx.frame_settings.foosmen_predictions = makePtr< foosmen_predictions_t >();
+  }
+  ctx.frame_settings.motion_gate.enabled = motion_gate;
+  ctx.spots_early_commit = early_commit;
+  ctx.spots_tracker.set_window(spots_window, spots_depth);
+  ctx.spots_tracker.set_beam(beam_width);
+  if (!ball_stream_name.empty() && !do_not_track_spots) {
+    ball_stream.open(ball_stream_name);
+    ctx.spots_ball_stream = true;
+  }
 
   // Initialize panel (GUI)
   init_control_panel(panel);
   set_log_level(panel, "gio", DEBUG);
 
+  // Take the state of the previous run, when there is one
+  if (resume) {
+    TrackerState state;
+    if (checkpoint_name.empty()) {
+      cerr << "--resume needs a --checkpoint file, starting from scratch" << endl;
+    } else if (load_checkpoint(state, checkpoint_name)) {
+      ctx.resume(state);
+      cerr << "Resuming from " << checkpoint_name << endl;
+    } else {
+      cerr << "Cannot read checkpoint " << checkpoint_name << ", starting from scratch" << endl;
+    }
+  }
+
   auto f = open_frame_cycle(videoName, panel);
   f->start();
   feed_frames(*f, ctx);
@@ -206,6 +372,38 @@ int main(int argc, char* argv[]) {
   // Graciously wait for the reader thread to stop
   delete f;
 
+  if (ball_window) {
+    cerr << "Fraction of pixels searched for the ball: " << ctx.ball_search_window.get_searched_fraction() << endl;
+  }
+  if (predict_rods) {
+    for (int side = 0; side < 2; side++) {
+      for (int bar = 0; bar < BARS; bar++) {
+        const rod_prediction_t &prediction = ctx.frame_settings.foosmen_predictions->bars[bar][side];
+        cerr << "Rod " << side << "-" << bar << ": fraction of shifts searched " << prediction.searched_fraction()
+             << ", fallback rate " << prediction.fallback_rate() << endl;
+      }
+    }
+  }
+
+  if (motion_gate) {
+    cerr << "Motion gate: fraction of tiles skipped " << ctx.motion_gate.get_skipped_fraction()
+         << ", idle frames " << ctx.motion_gate.get_idle_frames() << " of " << ctx.motion_gate.get_frames() << endl;
+  }
+
+  if (!do_not_track_spots) {
+    cerr << "Ball output latency in frames: mean " << ctx.spots_tracker.get_mean_latency()
+         << ", median " << ctx.spots_tracker.get_latency_percentile(0.5)
+         << ", 90th percentile " << ctx.spots_tracker.get_latency_percentile(0.9)
+         << ", 99th percentile " << ctx.spots_tracker.get_latency_percentile(0.99)
+         << ", max " << ctx.spots_tracker.get_latency_percentile(1.0) << endl;
+  }
+  if (ctx.spots_ball_stream) {
+    cerr << "Provisional ball positions corrected: " << ctx.corrected_frames << " of " << ctx.provisional_frames << endl;
+  }
+  if (!checkpoint_name.empty()) {
+    cerr << "Checkpoints written: " << checkpoints_written << endl;
+  }
+
   return 0;
 
 }
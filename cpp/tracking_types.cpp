@@ -50,3 +50,12 @@ void table_tracking_status_t::detect_features() {
   drawKeypoints(this->scaled_reference, this->reference_features, this->scaled_reference_with_keypoints, Scalar::all(-1), DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
 
 }
+
+void table_tracking_status_t::restore_features(const std::vector<cv::KeyPoint> &features) {
+
+  this->scaled_reference = this->reference.image;
+  this->scaled_mask = this->reference.mask;
+  this->reference_features = features;
+  drawKeypoints(this->scaled_reference, this->reference_features, this->scaled_reference_with_keypoints, Scalar::all(-1), DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+
+}
@@ -67,6 +67,8 @@ struct table_tracking_status_t {
 
   table_tracking_status_t(const table_tracking_params_t& params, const SubottoReference& reference, const Size &table_frame_size);
   void detect_features();
+  // Take the features found by detect_features() in an earlier run
+  void restore_features(const std::vector<cv::KeyPoint> &features);
 };
 
 struct table_tracking_t {
@@ -25,7 +25,9 @@ SOURCES += main.cpp\
     cv.cpp \
     coordinates.cpp \
     frameanalysis_tracking.cpp \
-    spotstracker.cpp
+    spotstracker.cpp \
+    ../../cpp/color_lut.cpp \
+    ../../cpp/local_maxima.cpp
 
 HEADERS  += mainwindow.h \
     videowidget.h \
@@ -46,7 +48,14 @@ HEADERS  += mainwindow.h \
     coordinates.h \
     debugpanel.h \
     cv.h \
-    spotstracker.h
+    spotstracker.h \
+    ../../cpp/basic_spots_tracker.hpp \
+    ../../cpp/binary_io.hpp \
+    ../../cpp/color_lut.hpp \
+    ../../cpp/local_maxima.hpp \
+    ../../cpp/parallel.hpp \
+    ../../cpp/rod_profile.hpp \
+    ../../cpp/foosmen_mask.hpp
 
 FORMS    += mainwindow.ui \
     ballpanel.ui \
@@ -54,6 +63,9 @@ FORMS    += mainwindow.ui \
     beginningpanel.ui \
     debugpanel.ui
 
+# Some low level helpers are shared with the command line tracker
+INCLUDEPATH += ../../cpp
+
 QMAKE_CXXFLAGS += -std=c++17 -march=native -g -DBOOST_ALL_DYN_LINK $$system(pkg-config --cflags opencv)
 QMAKE_LFLAGS += -lturbojpeg -lboost_log_setup -lboost_log -lboost_system -lboost_thread $$system(pkg-config --libs opencv)
 
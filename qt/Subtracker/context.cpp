@@ -134,9 +134,25 @@ void Context::working_thread()
 
         {
             FrameWaiter waiter(this->spots_waiter, frame_num);
+            this->spots_tracker.set_window(settings.spots_window, settings.spots_max_depth);
+            this->spots_tracker.set_beam(settings.spots_beam_width);
             this->spots_tracker.push_back(frame->get_spots(), frame->get_time().to_double());
             this->waiting_frames.push_back(frame);
-            while (this->waiting_frames.size() > this->settings.spots_tracking_len) {
+            // The frame carries its provisional position until it is
+            // committed
+            bool provisional_valid;
+            Point2f provisional_pos;
+            tie(provisional_valid, provisional_pos) = this->spots_tracker.back();
+            frame->set_ball(provisional_valid, provisional_pos);
+            {
+                unique_lock< mutex > lock(this->provisional_mutex);
+                this->provisional_ball.frame_num = frame_num;
+                this->provisional_ball.valid = provisional_valid;
+                this->provisional_ball.ball = provisional_pos;
+            }
+            while (!this->waiting_frames.empty() &&
+                   (this->waiting_frames.size() > this->settings.spots_tracking_len ||
+                    (this->settings.spots_early_commit && this->spots_tracker.front_settled()))) {
                 bool valid;
                 Point2f ball;
                 tie(valid, ball) = this->spots_tracker.front();
@@ -145,8 +161,20 @@ void Context::working_thread()
                 FrameAnalysis *out_frame = this->waiting_frames.front();
                 this->waiting_frames.pop_front();
                 assert(front_num == out_frame->get_frame_num());
+                tie(provisional_valid, provisional_pos) = out_frame->get_ball();
+                if (provisional_valid != valid || (valid && provisional_pos != ball)) {
+                    this->corrected_frames++;
+                }
                 out_frame->set_ball(valid, ball);
                 out_frame->do_rendering();
+                if (front_num % 1000 == 0) {
+                    BOOST_LOG_TRIVIAL(info) << "Ball output latency in frames: mean " << this->spots_tracker.get_mean_latency()
+                                            << ", median " << this->spots_tracker.get_latency_percentile(0.5)
+                                            << ", 90th percentile " << this->spots_tracker.get_latency_percentile(0.9)
+                                            << ", 99th percentile " << this->spots_tracker.get_latency_percentile(0.99)
+                                            << ", max " << this->spots_tracker.get_latency_percentile(1.0)
+                                            << "; provisional ball positions corrected " << this->corrected_frames << " of " << front_num + 1;
+                }
 
                 {
                     FrameWaiter waiter(this->output_waiter, front_num);
@@ -178,6 +206,11 @@ FrameAnalysis *Context::get() {
     return frame;
 }
 
+ProvisionalBall Context::get_provisional_ball() {
+    unique_lock< mutex > lock(this->provisional_mutex);
+    return this->provisional_ball;
+}
+
 void Context::wait() {
     unique_lock< mutex > lock(this->output_mutex);
     while (this->output == NULL) {
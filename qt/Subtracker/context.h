@@ -12,11 +12,21 @@
 #include <set>
 #include <condition_variable>
 
+// Ball position of a frame as soon as it is analyzed, from the best
+// track up to it; the frame is output later, with the final position
+struct ProvisionalBall {
+    int frame_num = -1;
+    bool valid = false;
+    cv::Point2f ball;
+};
+
 class Context
 {
 public:
     Context(size_t slave_num, FrameProducer *producer, const FrameSettings &settings);
     FrameAnalysis *get();
+    // Provisional ball position of the last analyzed frame
+    ProvisionalBall get_provisional_ball();
     void wait();
     FrameAnalysis *maybe_get();
     ~Context();
@@ -43,6 +53,10 @@ private:
     FrameWaiterContext spots_waiter;
     SpotsTracker spots_tracker;
     std::deque< FrameAnalysis* > waiting_frames;
+    int corrected_frames = 0;
+
+    std::mutex provisional_mutex;
+    ProvisionalBall provisional_ball;
 
     std::mutex output_mutex;
     std::condition_variable output_empty, output_full;
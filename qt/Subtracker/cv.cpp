@@ -5,6 +5,7 @@
 
 #include "cv.h"
 #include "logging.h"
+#include "local_maxima.hpp"
 
 using namespace std;
 using namespace cv;
@@ -134,23 +135,5 @@ double evaluate_ECC_rho(InputArray templateImage, InputArray inputImage, InputAr
 }
 
 vector<pair<Point, float>> find_local_maxima(Mat density, int x_rad, int y_rad, int max_count) {
-    Mat dilatedDensity;
-    dilate(density, dilatedDensity, Mat::ones(2 * y_rad + 1, 2 * x_rad + 1, CV_8U));
-
-    Mat localMaxMask = (density >= dilatedDensity);
-
-    vector<Point> nonZero;
-    findNonZero(localMaxMask, nonZero);
-
-    vector<pair<Point, float>> localMaxima;
-    for (const auto &p : nonZero) {
-        float w = density.at<float>(p);
-        localMaxima.push_back(make_pair(p, w));
-    }
-
-    int count = min(localMaxima.size(), size_t(max_count));
-    nth_element(localMaxima.begin(), localMaxima.begin() + count, localMaxima.end(), [](const auto &a, const auto &b){ return a.second > b.second; });
-    localMaxima.resize(count);
-
-    return localMaxima;
+    return find_top_local_maxima(density, x_rad, y_rad, max_count);
 }
@@ -5,11 +5,14 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <optional>
 
 #include "frameanalysis.h"
 #include "logging.h"
 #include "coordinates.h"
 #include "cv.h"
+#include "parallel.hpp"
+#include "rod_profile.hpp"
 
 using namespace std;
 using namespace chrono;
@@ -25,64 +28,112 @@ void FrameAnalysis::push_debug_frame(Mat &frame)
     this->debug.push_back(frame);
 }
 
-void FrameAnalysis::compute_table_ll() {
-    // FIXME - Can this be expressed in terms of optimized lower level operations?
-    // First addend is easy, but I do not know how to multiply components in the second
-    this->table_ll = Mat(this->table_frame.size(), CV_32F);
-    assert(this->table_ll.isContinuous());
-    auto it = this->table_ll.begin< float >();
-    auto it_end = this->table_ll.end< float >();
-    auto it2 = this->table_frame_diff2.begin< Vec< float, 3 > >();
-    auto it3 = this->table_frame_var.begin< Vec< float, 3 > >();
-    for (; it != it_end; ++it) {
-        //*it = -0.5 * ((*it2)[0] + (*it2)[1] + (*it2)[2]);
-        *it = -0.5 * ((*it2)[0] / (*it3)[0] + (*it2)[1] / (*it3)[1] + (*it2)[2] / (*it3)[2]) - 0.5 * log(2 * M_PI * (*it3)[0] * (*it3)[1] * (*it3)[2]);
-        ++it2;
-        ++it3;
+// Log-likelihood of a pixel for an object color, given factor = -0.5 /
+// stddev^2 and the normalization offset
+static inline float object_ll(const Scalar &mean, float factor, float offset, const float *pixel) {
+    float sum = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        float diff = pixel[c] - mean[c];
+        sum += diff * diff;
     }
-    this->push_debug_frame(this->table_ll);
+    return factor * sum + offset;
 }
 
-void FrameAnalysis::compute_objects_ll(int color) {
-    Mat tmp;
-    auto diff = this->float_table_frame - this->settings.objects_colors[color];
-    float factor = -0.5f / (this->settings.objects_color_stddev[color] * this->settings.objects_color_stddev[color]);
-    Matx< float, 1, 3 > t = { factor, factor, factor };
-    transform(diff.mul(diff), tmp, t);
-    this->objects_ll[color] = tmp - 3.0f/2.0f * log(2 * M_PI * this->settings.objects_color_stddev[color]);
+void FrameAnalysis::compute_objects_ll() {
+    // All the objects are done in one pass over the frame, and their
+    // planes are stacked in the same buffer
+    int rows = this->float_table_frame.rows;
+    int cols = this->float_table_frame.cols;
+    this->objects_planes.create(3 * rows, cols, CV_32F);
+    float factors[3], offsets[3];
+    Ptr< const ColorLUT > luts[3];
+    for (int color = 0; color < 3; color++) {
+        float stddev = this->settings.objects_color_stddev[color];
+        factors[color] = -0.5f / (stddev * stddev);
+        offsets[color] = - 3.0f/2.0f * log(2 * M_PI * stddev);
+        this->objects_ll[color] = this->objects_planes.rowRange(color * rows, (color + 1) * rows);
+    }
+    if (this->settings.objects_color_lut) {
+        // Frames are analyzed concurrently, but they share the tables
+        lock_guard< mutex > lock(this->frame_ctx.objects_luts_mutex);
+        for (int color = 0; color < 3; color++) {
+            const Scalar &mean = this->settings.objects_colors[color];
+            vector< float > params = { float(mean[0]), float(mean[1]), float(mean[2]), this->settings.objects_color_stddev[color] };
+            luts[color] = this->frame_ctx.objects_luts[color].get(params, [&](const Vec3f &pixel) {
+                return object_ll(mean, factors[color], offsets[color], pixel.val);
+            });
+        }
+    }
+
+    for (int y = 0; y < rows; y++) {
+        const float *pixels = this->float_table_frame.ptr< float >(y);
+        for (int color = 0; color < 3; color++) {
+            float *ll_row = this->objects_ll[color].ptr< float >(y);
+            if (luts[color]) {
+                luts[color]->apply_row(pixels, ll_row, cols);
+            } else {
+                const Scalar &mean = this->settings.objects_colors[color];
+                for (int x = 0; x < cols; x++) {
+                    ll_row[x] = object_ll(mean, factors[color], offsets[color], pixels + 3 * x);
+                }
+            }
+        }
+    }
 }
 
 // TODO - Implement rotation estimation
 void FrameAnalysis::find_foosmen() {
-    for (uint8_t rod = 0; rod < this->settings.rod_num; rod++) {
-        FrameSettings::RodParams &params = this->settings.rod_configuration[rod];
-        const Mat &ll = this->objects_ll[params.side];
-        int x1 = floor(table_frame_rod_x(this->settings, this->intermediate_size, rod - 0.5 * this->settings.foosmen_strip_width));
-        int x2 = ceil(table_frame_rod_x(this->settings, this->intermediate_size, rod + 0.5 * this->settings.foosmen_strip_width));
-        x1 = max(x1, 0);
-        x2 = min(x2, ll.cols-1);
-        Mat strip = Mat(ll, Range::all(), Range(x1, x2+1)).clone();
-        Mat reduced_strip;
-        reduce(strip, reduced_strip, 1, REDUCE_AVG, -1);
-        Mat blurred_strip;
-        blur(reduced_strip, blurred_strip, Size(1, this->settings.foosmen_blur_size));
-        double translation_len = convert_phys_to_table_frame_y(this->settings, this->intermediate_size, params.dist) - convert_phys_to_table_frame_y(this->settings, this->intermediate_size, 0.0);
-        Mat replicated_strip = blurred_strip.clone();
-        for (uint8_t i = 1; i < params.num; i++) {
-            Mat translated_strip;
-            Mat trans_mat = Mat(Matx< float, 2, 3 >(1.0, 0.0, 0.0, 0.0, 1.0, i*translation_len));
-            warpAffine(blurred_strip, translated_strip, trans_mat, blurred_strip.size(), INTER_LINEAR | WARP_INVERSE_MAP, BORDER_CONSTANT, Scalar(numeric_limits< float >::lowest()));
-            replicated_strip += translated_strip;
+    // The predictions come from the previous frame, so with them the
+    // frames go through here in order; the others pass their turn
+    // without waiting
+    optional< FrameWaiter > waiter;
+    bool predict = this->settings.foosmen_predict_shift;
+    if (predict) {
+        waiter.emplace(frame_ctx.foosmen_waiter, this->frame_num);
+    } else {
+        FrameWaiter::skip(frame_ctx.foosmen_waiter, this->frame_num);
+    }
+    rod_search_params_t search_params;
+    search_params.predict = predict;
+    search_params.radius = fabs(convert_phys_to_table_frame_y(this->settings, this->intermediate_size, this->settings.foosmen_predict_radius) - convert_phys_to_table_frame_y(this->settings, this->intermediate_size, 0.0));
+
+    // The rods are independent, and each one only writes its own shift
+    // and prediction
+    parallel_for_range(Range(0, this->settings.rod_num), [&](const Range &range) {
+        for (int rod = range.start; rod < range.end; rod++) {
+            FrameSettings::RodParams &params = this->settings.rod_configuration[rod];
+            const Mat &ll = this->objects_ll[params.side];
+            int x1 = floor(table_frame_rod_x(this->settings, this->intermediate_size, rod - 0.5 * this->settings.foosmen_strip_width));
+            int x2 = ceil(table_frame_rod_x(this->settings, this->intermediate_size, rod + 0.5 * this->settings.foosmen_strip_width));
+            x1 = max(x1, 0);
+            x2 = min(x2, ll.cols-1);
+            Mat strip = Mat(ll, Range::all(), Range(x1, x2+1)).clone();
+            Mat reduced_strip;
+            reduce(strip, reduced_strip, 1, REDUCE_AVG, -1);
+            Mat blurred_strip;
+            blur(reduced_strip, blurred_strip, Size(1, this->settings.foosmen_blur_size));
+            double translation_len = convert_phys_to_table_frame_y(this->settings, this->intermediate_size, params.dist) - convert_phys_to_table_frame_y(this->settings, this->intermediate_size, 0.0);
+            // Correlate the profile with the comb of the foosmen of the rod
+            vector< float > offsets;
+            for (uint8_t i = 0; i < params.num; i++) {
+                offsets.push_back(i * translation_len);
+            }
+            rod_prediction_t unpredicted;
+            rod_prediction_t &prediction = predict ? this->frame_ctx.rod_predictions[rod] : unpredicted;
+            double y = search_rod_shift(blurred_strip.ptr< float >(), blurred_strip.rows, offsets, blurred_strip.rows, true, search_params, prediction);
+            this->rods[rod].shift = convert_table_frame_to_phys_y(settings, this->intermediate_size, y) - foosman_y(this->settings, rod, 0);
+            if (false && rod == 3) {
+                this->push_debug_frame(strip);
+                this->push_debug_frame(reduced_strip);
+                this->push_debug_frame(blurred_strip);
+            }
         }
-        replicated_strip /= params.num;
-        Point max_point;
-        minMaxLoc(replicated_strip, NULL, NULL, NULL, &max_point);
-        this->rods[rod].shift = convert_table_frame_to_phys_y(settings, this->intermediate_size, max_point.y) - foosman_y(this->settings, rod, 0);
-        if (false && rod == 3) {
-            this->push_debug_frame(strip);
-            this->push_debug_frame(reduced_strip);
-            this->push_debug_frame(blurred_strip);
-            this->push_debug_frame(replicated_strip);
+    }, this->settings.rod_num);
+
+    if (predict && this->frame_num % 1000 == 0) {
+        for (uint8_t rod = 0; rod < this->settings.rod_num; rod++) {
+            const rod_prediction_t &prediction = this->frame_ctx.rod_predictions[rod];
+            BOOST_LOG_TRIVIAL(info) << "Rod " << int(rod) << ": fraction of shifts searched " << prediction.searched_fraction() << ", fallback rate " << prediction.fallback_rate();
         }
     }
 }
@@ -95,34 +146,72 @@ void FrameAnalysis::update_mean() {
         this->frame_ctx.mean_started = true;
     }
 
-    // Compute a foosmen mask, so that we don't spoil the background with them
-    Mat foosmen_mask = Mat(this->intermediate_size, CV_8U, Scalar(255));
-    //Mat temp2 = this->table_frame.clone();
-    double rect_length = 2.0 * (convert_phys_to_table_frame_x(this->settings, this->intermediate_size, this->settings.foosman_foot) - convert_phys_to_table_frame_x(this->settings, this->intermediate_size, 0.0));
-    double rect_width = 2.0 * (convert_phys_to_table_frame_y(this->settings, this->intermediate_size, this->settings.foosman_width) - convert_phys_to_table_frame_y(this->settings, this->intermediate_size, 0.0));
+    // Stamp the foosmen, so that we don't spoil the background with
+    // them; the stamps are only recomputed when the geometry changes
+    vector< float > stamps_params = { float(this->intermediate_size.width), float(this->intermediate_size.height),
+                                      this->settings.table_length, this->settings.table_width, this->settings.rod_distance,
+                                      this->settings.foosman_foot, this->settings.foosman_width };
     for (uint8_t rod = 0; rod < this->settings.rod_num; rod++) {
-        FrameSettings::RodParams &params = this->settings.rod_configuration[rod];
-        for (uint8_t fm = 0; fm < params.num; fm++) {
-            Point fm_center = transform_point(foosman_coords(this->settings, rod, fm) + Point2f(0.0, this->rods[rod].shift), compute_physical_rectangle(this->settings), compute_table_frame_rectangle(this->intermediate_size));
-            Point displ = Point(0.5 * rect_length, 0.5 * rect_width);
-            rectangle(foosmen_mask, fm_center - displ, fm_center + displ, Scalar(0), CV_FILLED);
-            //rectangle(temp2, fm_center - displ, fm_center + displ, Scalar(0.0, 0.0, 0.0), CV_FILLED);
+        stamps_params.push_back(this->settings.rod_configuration[rod].num);
+        stamps_params.push_back(this->settings.rod_configuration[rod].dist);
+    }
+    if (stamps_params != this->frame_ctx.foosmen_stamps_params) {
+        double y0 = convert_phys_to_table_frame_y(this->settings, this->intermediate_size, 0.0);
+        int half_length = cvRound(fabs(convert_phys_to_table_frame_x(this->settings, this->intermediate_size, this->settings.foosman_foot) - convert_phys_to_table_frame_x(this->settings, this->intermediate_size, 0.0)));
+        int half_width = cvRound(fabs(convert_phys_to_table_frame_y(this->settings, this->intermediate_size, this->settings.foosman_width) - y0));
+        this->frame_ctx.foosmen_stamps = FoosmenMask();
+        for (uint8_t rod = 0; rod < this->settings.rod_num; rod++) {
+            int x = cvRound(table_frame_rod_x(this->settings, this->intermediate_size, rod));
+            vector< float > centers;
+            for (uint8_t fm = 0; fm < this->settings.rod_configuration[rod].num; fm++) {
+                centers.push_back(table_frame_foosman_y(this->settings, this->intermediate_size, rod, fm));
+            }
+            this->frame_ctx.foosmen_stamps.add_rod(x - half_length, x + half_length, centers, half_width);
         }
+        this->frame_ctx.foosmen_stamps_scale = convert_phys_to_table_frame_y(this->settings, this->intermediate_size, 1.0) - y0;
+        this->frame_ctx.foosmen_stamps_params = stamps_params;
+    }
+    FoosmenMask foosmen_mask = this->frame_ctx.foosmen_stamps;
+    for (uint8_t rod = 0; rod < this->settings.rod_num; rod++) {
+        foosmen_mask.set_shift(rod, this->rods[rod].shift * this->frame_ctx.foosmen_stamps_scale);
     }
 
-    // Update the running average
-    // FIXME - The accumulation coefficient should be expressed in terms of absolute time, not frame number
-    accumulateWeighted(this->float_table_frame, this->frame_ctx.table_frame_mean, this->settings.accumul_coeff, foosmen_mask);
-    auto diff = this->float_table_frame - this->frame_ctx.table_frame_mean;
-    this->table_frame_diff2 = diff.mul(diff);
-    accumulateWeighted(this->table_frame_diff2, this->frame_ctx.table_frame_var, this->settings.accumul_coeff, foosmen_mask);
+    // Update the running average, and compute the table likelihood
+    // with the updated values in the same pass; done run by run, so
+    // that the foosmen are skipped without testing every pixel
+    const float alpha = this->settings.accumul_coeff;
+    Mat &mean = this->frame_ctx.table_frame_mean;
+    Mat &var = this->frame_ctx.table_frame_var;
+    this->table_ll = Mat(this->intermediate_size, CV_32F);
+    int width = this->intermediate_size.width;
+    vector< Range > spans;
+    for (int y = 0; y < this->intermediate_size.height; y++) {
+        const float *frame_row = this->float_table_frame.ptr< float >(y);
+        float *mean_row = mean.ptr< float >(y);
+        float *var_row = var.ptr< float >(y);
+        float *ll_row = this->table_ll.ptr< float >(y);
+        foosmen_mask.for_each_run(y, width, spans, [&](int start, int end, bool masked) {
+            bool update = !masked;
+            for (int x = start; x < end; x++) {
+                float diff2[3];
+                for (int c = 0; c < 3; c++) {
+                    int i = 3 * x + c;
+                    if (update) mean_row[i] = (1.0f - alpha) * mean_row[i] + alpha * frame_row[i];
+                    float diff = frame_row[i] - mean_row[i];
+                    diff2[c] = diff * diff;
+                    if (update) var_row[i] = (1.0f - alpha) * var_row[i] + alpha * diff2[c];
+                }
+                const float *v = var_row + 3 * x;
+                //ll_row[x] = -0.5 * (diff2[0] + diff2[1] + diff2[2]);
+                ll_row[x] = -0.5 * (diff2[0] / v[0] + diff2[1] / v[1] + diff2[2] / v[2]) - 0.5 * log(2 * M_PI * v[0] * v[1] * v[2]);
+            }
+        });
+    }
 
-    this->table_frame_mean = this->frame_ctx.table_frame_mean;
-    this->table_frame_var = this->frame_ctx.table_frame_var;
+    this->table_frame_mean = mean;
+    this->table_frame_var = var;
     this->push_debug_frame(this->table_frame_mean);
-    /*Mat temp = 10.0 * (foosmen_mask - 1.0);
-    this->push_debug_frame(temp);
-    this->push_debug_frame(temp2);*/
+    this->push_debug_frame(this->table_ll);
 }
 
 void FrameAnalysis::find_ball() {
@@ -213,6 +302,11 @@ void FrameAnalysis::set_ball(bool valid, Point2f ball)
     this->ball = ball;
 }
 
+std::tuple< bool, Point2f > FrameAnalysis::get_ball() const
+{
+    return make_tuple(this->ball_is_present, this->ball);
+}
+
 void FrameAnalysis::do_things()
 {
     this->begin_steady_time = steady_clock::now();
@@ -234,12 +328,9 @@ void FrameAnalysis::do_things()
         warpPerspective(this->frame, this->table_frame, homography, this->intermediate_size, INTER_LINEAR | WARP_INVERSE_MAP);
         this->table_frame.convertTo(this->float_table_frame, CV_32FC3, 1.0/255.0);
 
-        for (int color = 0; color < 3; color++) {
-            this->compute_objects_ll(color);
-        }
+        this->compute_objects_ll();
         this->find_foosmen();
         this->update_mean();
-        this->compute_table_ll();
         this->find_ball();
 
         // Assume that the best maximum is the ball
@@ -248,6 +339,7 @@ void FrameAnalysis::do_things()
         this->ball = this->spots[0].first;*/
     } else {
         // Even if we do nothing, we have to acknowledge the frame to the skipped waiter, otherwise it will block all the other frames
+        FrameWaiter foosmen_waiter(frame_ctx.foosmen_waiter, this->frame_num);
         FrameWaiter waiter(frame_ctx.table_frame_waiter, this->frame_num);
     }
 
@@ -2,6 +2,8 @@
 #define FRAMEANALYSIS_H
 
 #include <chrono>
+#include <mutex>
+#include <tuple>
 #include <opencv2/core/core.hpp>
 #include <opencv2/xfeatures2d.hpp>
 
@@ -13,6 +15,9 @@
 #include "framereader.h"
 #include "framewaiter.h"
 #include "spotstracker.h"
+#include "color_lut.hpp"
+#include "rod_profile.hpp"
+#include "foosmen_mask.hpp"
 
 std::string getImgType(int imgTypeInt);
 
@@ -39,6 +44,21 @@ struct FrameContext {
     bool mean_started = false;
     cv::Mat table_frame_mean;
     cv::Mat table_frame_var;
+    // Foosmen kept out of the background, stamped for null rod shifts
+    // and rebuilt when the settings they depend on change; the shifts
+    // are converted to table frame rows with foosmen_stamps_scale
+    std::vector< float > foosmen_stamps_params;
+    FoosmenMask foosmen_stamps;
+    double foosmen_stamps_scale = 0.0;
+
+    // Tables of the objects color models, shared by the frames analyzed
+    // concurrently, hence the mutex
+    std::mutex objects_luts_mutex;
+    ColorLUTCache objects_luts[3];
+
+    // Predictive search of the rods, which needs the frames in order
+    FrameWaiterContext foosmen_waiter;
+    rod_prediction_t rod_predictions[FrameSettings::rod_num];
 };
 
 struct ThreadContext {
@@ -72,13 +92,15 @@ public:
     std::vector<Spot> get_spots() const;
     FrameClockTimePoint get_time() const;
     int get_frame_num() const;
+    // The ball is first set to the provisional position, then replaced
+    // by the final one when the frame is committed
     void set_ball(bool valid, cv::Point2f ball);
+    std::tuple< bool, cv::Point2f > get_ball() const;
     void do_rendering();
 
 private:
     void push_debug_frame(cv::Mat &frame);
-    void compute_table_ll();
-    void compute_objects_ll(int color);
+    void compute_objects_ll();
     void track_table();
     void check_table_inversion();
     void find_foosmen();
@@ -106,10 +128,11 @@ private:
 
     cv::Size intermediate_size;
     cv::Mat table_frame, float_table_frame;
+    // The three objects planes are stacked in objects_planes
+    cv::Mat objects_planes;
     cv::Mat objects_ll[3];
     cv::Mat table_frame_mean;
     cv::Mat table_frame_var;
-    cv::Mat table_frame_diff2;
     cv::Mat table_ll;
     std::vector< std::pair< cv::Point2f, float > > spots;
 
@@ -17,6 +17,8 @@ struct FrameSettings {
     // OpenCV uses BGR colors; indexes are: 0 -> red foosmen, 1 -> blue foosmen, 2 -> ball
     cv::Scalar objects_colors[3] = { { 0.0f, 0.0f, 1.0f}, { 1.0f, 0.0f, 0.0f }, { 0.85f, 0.85f, 0.85f } };
     float objects_color_stddev[3] = { 0.15f, 0.15f, 0.075f };
+    // Read the objects likelihoods from precomputed tables (see cpp/color_lut.hpp)
+    bool objects_color_lut = true;
     cv::Scalar initial_mean = { 135.0/255.0, 150.0/255.0, 120.0/255.0 };
     cv::Scalar initial_var = { (20.0/255.0)*(20.0/255.0), (20.0/255.0)*(20.0/255.0), (20.0/255.0)*(20.0/255.0) };
 
@@ -55,6 +57,10 @@ struct FrameSettings {
     // Foosmen detection
     double foosmen_strip_width = 0.1;
     int foosmen_blur_size = 10;
+    // Search each rod only around the shift predicted from its velocity
+    // (see cpp/rod_profile.hpp); the radius is in meters
+    bool foosmen_predict_shift = false;
+    double foosmen_predict_radius = 0.01;
 
     // Running average
     float accumul_coeff = 0.002f;
@@ -65,8 +71,17 @@ struct FrameSettings {
     uint8_t maxima_count = 5;
     uint8_t maxima_radius = 15;
 
-    // Spots tracking
+    // Spots tracking; with early commit a frame is output as soon as
+    // all the ball tracks agree on it, and at the latest after
+    // spots_tracking_len more frames
     uint32_t spots_tracking_len = 200;
+    bool spots_early_commit = false;
+    // The ball is tracked through the frames of the last spots_window
+    // seconds, but through no more than spots_max_depth frames, and only
+    // through the spots_beam_width best spots of each (0 for all of them)
+    double spots_window = 0.5;
+    uint32_t spots_max_depth = 120;
+    int spots_beam_width = 0;
 
     // Actual size in meters (not all of them are actually used in computation)
     float table_length = 1.14f;
@@ -4,6 +4,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <set>
 
 class FrameWaiterContext {
     friend class FrameWaiter;
@@ -11,6 +12,8 @@ private:
     std::mutex mutex;
     std::condition_variable cond;
     int frame_num = 0;
+    // Frames that passed their turn with FrameWaiter::skip() before it came
+    std::set< int > skipped;
 };
 
 class FrameWaiter
@@ -29,15 +32,38 @@ public:
             ctx.cond.wait_for(this->lock, std::chrono::seconds(1));
         }
         ctx.frame_num++;
+        advance(ctx);
     }
 
     ~FrameWaiter() {
         ctx.cond.notify_all();
     }
 
+    // Pass the turn of a frame that does not need it, without waiting
+    // for the previous frames
+    static void skip(FrameWaiterContext &ctx, int current_frame_num) {
+        {
+            std::unique_lock< std::mutex > lock(ctx.mutex);
+            if (ctx.frame_num == current_frame_num) {
+                ctx.frame_num++;
+                advance(ctx);
+            } else {
+                ctx.skipped.insert(current_frame_num);
+            }
+        }
+        ctx.cond.notify_all();
+    }
+
     bool interrupted_by_callback;
 
 private:
+    static void advance(FrameWaiterContext &ctx) {
+        while (!ctx.skipped.empty() && *ctx.skipped.begin() == ctx.frame_num) {
+            ctx.skipped.erase(ctx.skipped.begin());
+            ctx.frame_num++;
+        }
+    }
+
     FrameWaiterContext &ctx;
     std::unique_lock< std::mutex > lock;
 };
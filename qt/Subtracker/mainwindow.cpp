@@ -31,6 +31,7 @@ MainWindow::MainWindow(QWidget *parent) :
     this->timer.setInterval(50);
     this->mem_timer.setInterval(100);
     connect(&this->timer, SIGNAL(timeout()), this, SLOT(update()));
+    connect(&this->timer, SIGNAL(timeout()), this, SLOT(update_provisional_ball()));
     connect(&this->mem_timer, SIGNAL(timeout()), this, SLOT(update_mem()));
     this->mem_timer.start();
     this->update_mem();
@@ -178,6 +179,17 @@ static inline string size_to_string(size_t size) {
     return stream.str();
 }
 
+static inline string ball_to_string(int frame_num, bool valid, const Point2f &ball) {
+    ostringstream stream;
+    stream << "frame " << frame_num << ": ";
+    if (valid) {
+        stream << fixed << setprecision(3) << ball.x << ", " << ball.y;
+    } else {
+        stream << "not found";
+    }
+    return stream.str();
+}
+
 void MainWindow::receive_frame()
 {
     BOOST_LOG_NAMED_SCOPE("when frame produced");
@@ -198,6 +210,7 @@ void MainWindow::receive_frame()
     this->pass_string_to_label(this->ui->phase2Time, duration_to_string(frame->phase2_time()).c_str());
     this->pass_string_to_label(this->ui->phase3Time, duration_to_string(frame->phase3_time()).c_str());*/
     this->pass_string_to_label(this->ui->totalProcessingTime, duration_to_string(frame->total_processing_time()).c_str());
+    this->pass_string_to_label(this->ui->ball, ball_to_string(frame->frame_num, frame->ball_is_present, frame->ball).c_str());
 
     for (auto &sub_frame : this->sub_frames) {
         sub_frame->receive_frame(frame);
@@ -218,6 +231,19 @@ void MainWindow::update_mem()
     this->update();
 }
 
+void MainWindow::update_provisional_ball()
+{
+    // The committed frames lag behind by the tracker window, the
+    // provisional position is the one of the last analyzed frame
+    if (this->worker.isNull()) {
+        return;
+    }
+    ProvisionalBall provisional = this->worker->get_provisional_ball();
+    if (provisional.frame_num >= 0) {
+        this->pass_string_to_label(this->ui->provisionalBall, ball_to_string(provisional.frame_num, provisional.valid, provisional.ball).c_str());
+    }
+}
+
 void MainWindow::when_worker_finished() {
     this->worker->wait();
     delete this->worker;
@@ -42,6 +42,7 @@ private slots:
     void on_actionStart_triggered();
     void on_actionStop_triggered();
     void update_mem();
+    void update_provisional_ball();
 
 public slots:
     void receive_frame();
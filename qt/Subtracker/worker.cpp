@@ -38,6 +38,10 @@ QSharedPointer< FrameAnalysis > Worker::get_last_frame() {
     return this->last_frame;
 }
 
+ProvisionalBall Worker::get_provisional_ball() {
+    return this->context.get_provisional_ball();
+}
+
 int Worker::get_queue_length()
 {
     return this->jpeg_reader.get_queue_length();
@@ -19,6 +19,7 @@ public:
     void set_settings(const FrameSettings &settings);
     std::pair<std::unique_lock<std::mutex>, FrameCommands *> edit_commands();
     QSharedPointer<FrameAnalysis> get_last_frame();
+    ProvisionalBall get_provisional_ball();
     int get_queue_length();
 
 signals:
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <vector>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "context.hpp"
+#include "half_float.hpp"
+#include "utility.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Run the same recording through a full precision and a compact
+// (half float) background, and report how much the results differ; the
+// test fails when the mean errors or the best spot disagreements go
+// over the bounds given in main()
+struct map_error_t {
+    double max = 0.0;
+    double sum = 0.0;
+    int count = 0;
+
+    void push(const Mat &a, const Mat &b) {
+        Mat diff;
+        absdiff(a, b, diff);
+        double frame_max;
+        minMaxLoc(diff.reshape(1), NULL, &frame_max);
+        this->max = std::max(this->max, frame_max);
+        this->sum += mean(diff.reshape(1))[0];
+        this->count++;
+    }
+
+    double mean_error() const {
+        return this->count ? this->sum / this->count : 0.0;
+    }
+
+    bool check(const string &name, double bound) const {
+        bool ok = this->mean_error() <= bound;
+        cerr << name << ": max abs error " << this->max << ", mean abs error " << this->mean_error()
+             << " (bound " << bound << ")" << (ok ? "" : " TOO HIGH") << endl;
+        return ok;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        cerr << "Usage: " << argv[0] << " <video> <reference subotto> [<reference subotto mask>]" << endl;
+        return 1;
+    }
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    Mat ref_frame = imread(argv[2]);
+    Mat ref_mask;
+    if (argc == 4) {
+        ref_mask = imread(argv[3], CV_LOAD_IMAGE_GRAYSCALE);
+    }
+
+    SubtrackerContext float_ctx(ref_frame, ref_mask, panel, true);
+    SubtrackerContext compact_ctx(ref_frame, ref_mask, panel, true);
+    compact_ctx.frame_settings.compact_background = true;
+
+    map_error_t mean_error, variance_error, nll_error, density_error;
+    int frames = 0, same_best_spot = 0, spot_frames = 0;
+    double max_spot_distance = 0.0;
+
+    auto f = open_frame_cycle(argv[1], panel);
+    f->start();
+    while (true) {
+        auto frame_info = f->get();
+        if (!frame_info.valid) break;
+
+        float_ctx.feed(frame_info.data, frame_info.time);
+        compact_ctx.feed(frame_info.data, frame_info.time);
+
+        FrameAnalysis *a, *b;
+        while ((a = float_ctx.get_processed_frame()) != NULL) {
+            b = compact_ctx.get_processed_frame();
+            assert(b != NULL && a->frame_num == b->frame_num);
+
+            Mat mean_a, mean_b, variance_a, variance_b;
+            load_map(a->table_description.mean, mean_a);
+            load_map(b->table_description.mean, mean_b);
+            load_map(a->table_description.variance, variance_a);
+            load_map(b->table_description.variance, variance_b);
+            mean_error.push(mean_a, mean_b);
+            variance_error.push(variance_a, variance_b);
+            nll_error.push(a->table_analysis.nll, b->table_analysis.nll);
+            density_error.push(a->ball_density, b->ball_density);
+
+            if (!a->spots.empty() && !b->spots.empty()) {
+                auto best = [](const vector< Spot > &spots) {
+                    return *max_element(spots.begin(), spots.end(), [](const Spot &x, const Spot &y) { return x.weight < y.weight; });
+                };
+                double distance = norm(best(a->spots).center - best(b->spots).center);
+                max_spot_distance = max(max_spot_distance, distance);
+                if (distance < 0.005) same_best_spot++;
+                spot_frames++;
+            }
+
+            frames++;
+            delete a;
+            delete b;
+        }
+    }
+    delete f;
+
+    cerr << "Frames: " << frames << endl;
+    // The running averages are accumulated in full precision in both
+    // modes, so the maps may only differ where the foosmen mask moved;
+    // the corrected variance is half float, with a relative error of
+    // 2^-11, and that goes in the NLL and in the ball density
+    bool ok = frames > 0;
+    ok = mean_error.check("mean", 1.0 / 255.0) && ok;
+    ok = variance_error.check("variance", 1e-4) && ok;
+    ok = nll_error.check("table NLL", 0.05) && ok;
+    ok = density_error.check("ball density", 0.05) && ok;
+    cerr << "Best spot within 5mm: " << same_best_spot << " of " << spot_frames << " frames (max distance " << max_spot_distance << "m)" << endl;
+    ok = ok && same_best_spot >= 0.99 * spot_frames;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "context.hpp"
+#include "staging.hpp"
+#include "utility.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// Search the ball spots of a recording at full resolution and coarse
+// to fine with different downscalings, timing the density computation
+// and the search, and checking that the spots stay the same up to the
+// subpixel correction
+struct pyramid_run_t {
+    int scale;
+    BallAnalysis ball_analysis;
+    Mat density;
+    double time[2] = { 0.0, 0.0 };
+    int spots = 0;
+    int matched_spots = 0;
+    double max_distance = 0.0;
+
+    pyramid_run_t(int scale) : scale(scale) {}
+};
+
+static double elapsed(steady_clock::time_point &begin) {
+    auto end = steady_clock::now();
+    double res = duration_cast< duration< double, milli > >(end - begin).count();
+    begin = end;
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        cerr << "Usage: " << argv[0] << " <video> <reference subotto> [<reference subotto mask>]" << endl;
+        return 1;
+    }
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    Mat ref_frame = imread(argv[2]);
+    Mat ref_mask;
+    if (argc == 4) {
+        ref_mask = imread(argv[3], CV_LOAD_IMAGE_GRAYSCALE);
+    }
+
+    SubtrackerContext ctx(ref_frame, ref_mask, panel, true);
+    const FrameSettings &settings = ctx.frame_settings;
+    // Spots closer than a pixel are the same
+    double tolerance = settings.table_metrics.length / settings.table_frame_size.width;
+
+    // The first run is the full resolution reference
+    vector< pyramid_run_t > runs = { 1, 2, 4 };
+    int frames = 0;
+    auto f = open_frame_cycle(argv[1], panel);
+    f->start();
+    while (true) {
+        auto frame_info = f->get();
+        if (!frame_info.valid) break;
+
+        ctx.feed(frame_info.data, frame_info.time);
+
+        FrameAnalysis *frame;
+        while ((frame = ctx.get_processed_frame()) != NULL) {
+            vector< Spot > reference;
+            for (auto &run : runs) {
+                vector< Spot > spots;
+                auto begin = steady_clock::now();
+                if (run.scale == 1) {
+                    do_ball_analysis(panel, frame->table_frame, frame->ball_description, frame->table_analysis, run.ball_analysis, run.density);
+                    run.time[0] += elapsed(begin);
+                    search_spots(panel, run.density, settings.local_maxima_limit, settings.local_maxima_min_distance, spots, settings.table_metrics, settings.table_frame_size, frame->frame_num);
+                    run.time[1] += elapsed(begin);
+                    reference = spots;
+                    continue;
+                }
+
+                do_coarse_ball_analysis(panel, frame->table_frame, frame->ball_description, frame->table_analysis, run.ball_analysis, run.density, run.scale);
+                run.time[0] += elapsed(begin);
+                search_spots_coarse_to_fine(panel, run.density, run.scale, frame->table_frame, frame->ball_description, frame->table_analysis, NULL, NULL,
+                                            settings.local_maxima_limit, settings.local_maxima_min_distance, spots, settings.table_metrics, settings.table_frame_size, frame->frame_num);
+                run.time[1] += elapsed(begin);
+
+                for (const auto &spot : reference) {
+                    double distance = INFINITY;
+                    for (const auto &other : spots) {
+                        distance = min(distance, double(norm(spot.center - other.center)));
+                    }
+                    run.spots++;
+                    if (distance <= tolerance) {
+                        run.matched_spots++;
+                    } else {
+                        run.max_distance = max(run.max_distance, distance);
+                    }
+                }
+            }
+            frames++;
+            delete frame;
+        }
+    }
+    delete f;
+
+    cerr << "Frames: " << frames << ", table frame size " << settings.table_frame_size << endl;
+    if (frames == 0) return 1;
+    for (const auto &run : runs) {
+        cerr << "Scale 1/" << run.scale << ": density " << run.time[0] / frames
+             << "ms, search " << run.time[1] / frames << "ms per frame" << endl;
+        if (run.scale > 1) {
+            cerr << "\tfull resolution spots found: " << run.matched_spots << " of " << run.spots
+                 << " (max distance of the others " << run.max_distance << "m)" << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include "blobs_tracker.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// Slide a timeline of the given length over the blobs of a ball bouncing
+// on the table, hidden from time to time, among random blobs, and
+// process it at every frame with the incremental and with the full
+// dynamic programming, timing both and checking that they give the same
+// positions
+int main(int argc, char* argv[]) {
+    int frames = 240;
+    if (argc >= 2) {
+        frames = atoi(argv[1]);
+    }
+
+    control_panel_t panel;
+    init_control_panel(panel);
+
+    bool ok = true;
+    for (int span : {120, 600}) {
+        BlobsTracker incremental(panel), full(panel);
+        full._incremental = false;
+        RNG rng(1618 + span);
+        Size2f table(1.135f, 0.7f);
+        Point2f ball(0.0f, 0.0f), speed(0.012f, 0.007f);
+        double incremental_time = 0.0, full_time = 0.0;
+        int mismatches = 0, calls = 0;
+
+        for (int i = 0; i < span + frames; i++) {
+            vector< Blob > blobs;
+            ball += speed;
+            if (fabs(ball.x) > table.width / 2) speed.x = -speed.x;
+            if (fabs(ball.y) > table.height / 2) speed.y = -speed.y;
+            int count = 5;
+            if (i % 50 < 40) {
+                Point2f noise(rng.uniform(-0.005f, 0.005f), rng.uniform(-0.005f, 0.005f));
+                blobs.push_back(Blob(ball + noise, 0.0, 0.0, rng.uniform(20.0, 40.0)));
+                count--;
+            }
+            for (int j = 0; j < count; j++) {
+                Point2f p(rng.uniform(-table.width / 2, table.width / 2), rng.uniform(-table.height / 2, table.height / 2));
+                blobs.push_back(Blob(p, 0.0, 0.0, rng.uniform(0.0, 25.0)));
+            }
+
+            auto begin = steady_clock::now();
+            incremental.InsertFrameInTimeline(blobs, i);
+            if (i >= span) incremental.PopFrameFromTimeline();
+            int front = incremental.GetFrontTime();
+            vector< Point2f > positions = incremental.ProcessFrames(0, front, front + 1);
+            auto middle = steady_clock::now();
+            full.InsertFrameInTimeline(blobs, i);
+            if (i >= span) full.PopFrameFromTimeline();
+            vector< Point2f > expected_positions = full.ProcessFrames(0, front, front + 1);
+            auto end = steady_clock::now();
+
+            // Only time the calls on a full timeline
+            if (i >= span) {
+                incremental_time += duration_cast< duration< double, milli > >(middle - begin).count();
+                full_time += duration_cast< duration< double, milli > >(end - middle).count();
+                calls++;
+            }
+            if (positions != expected_positions) {
+                mismatches++;
+            }
+        }
+
+        cerr << span << " frames timeline: full " << full_time / calls << "ms, incremental "
+             << incremental_time / calls << "ms per frame, " << mismatches << " mismatches" << endl;
+        ok = ok && mismatches == 0;
+    }
+    cerr << (ok ? "Positions match" : "Positions DO NOT match") << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "context.hpp"
+#include "checkpoint.hpp"
+#include "utility.hpp"
+
+using namespace cv;
+using namespace std;
+
+struct output_t {
+    bool ball_is_present;
+    Point2f ball;
+    float bars_shift[BARS][2];
+};
+
+static void collect(SubtrackerContext &ctx, map< int, output_t > &outputs, int offset) {
+
+    FrameAnalysis *frame_analysis;
+    while ((frame_analysis = ctx.get_processed_frame()) != NULL) {
+        output_t &output = outputs[frame_analysis->frame_num + offset];
+        output.ball_is_present = frame_analysis->ball_is_present;
+        output.ball = Point2f(frame_analysis->ball_pos_x, frame_analysis->ball_pos_y);
+        for (int side = 0; side < 2; side++) {
+            for (int bar = 0; bar < BARS; bar++) {
+                output.bars_shift[bar][side] = frame_analysis->bars_shift[bar][side];
+            }
+        }
+        delete frame_analysis;
+    }
+
+}
+
+// Compare the frames after the restart with the ones of the run that
+// went straight through; returns the number of frames it took to give
+// the same ball position and bar shifts (up to a pixel) from then on
+static int compare(const map< int, output_t > &expected, const map< int, output_t > &outputs, int restart, double tolerance,
+                   int &matches, int &compared) {
+
+    int last_mismatch = restart - 1;
+    matches = 0;
+    compared = 0;
+    for (const auto &item : outputs) {
+        auto it = expected.find(item.first);
+        if (item.first < restart || it == expected.end()) continue;
+        const output_t &a = it->second, &b = item.second;
+        bool match = a.ball_is_present == b.ball_is_present && (!a.ball_is_present || norm(a.ball - b.ball) <= tolerance);
+        for (int side = 0; side < 2; side++) {
+            for (int bar = 0; bar < BARS; bar++) {
+                match = match && fabs(a.bars_shift[bar][side] - b.bars_shift[bar][side]) <= tolerance;
+            }
+        }
+        compared++;
+        matches += match;
+        if (!match) last_mismatch = item.first;
+    }
+    return last_mismatch - restart + 1;
+
+}
+
+// Analyze a recording straight through, and again restarting halfway:
+// once resuming from the checkpoint saved just before the restart, and
+// once from scratch; count the frames each restart takes to give the
+// same results as the straight run
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 5) {
+        cerr << "Usage: " << argv[0] << " <video> <reference subotto> [<reference subotto mask> [<restart frame>]]" << endl;
+        return 1;
+    }
+    int restart = argc >= 5 ? atoi(argv[4]) : 300;
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    Mat ref_frame = imread(argv[2]);
+    Mat ref_mask;
+    if (argc >= 4) {
+        ref_mask = imread(argv[3], CV_LOAD_IMAGE_GRAYSCALE);
+    }
+
+    SubtrackerContext straight_ctx(ref_frame, ref_mask, panel);
+    SubtrackerContext before_ctx(ref_frame, ref_mask, panel);
+    SubtrackerContext resumed_ctx(ref_frame, ref_mask, panel);
+    SubtrackerContext scratch_ctx(ref_frame, ref_mask, panel);
+    const FrameSettings &settings = straight_ctx.frame_settings;
+    double tolerance = settings.table_metrics.length / settings.table_frame_size.width;
+    string checkpoint_name = "checkpoint_test.state";
+
+    map< int, output_t > straight, resumed, scratch;
+    int frames = 0;
+    auto f = open_frame_cycle(argv[1], panel);
+    f->start();
+    while (true) {
+        auto frame_info = f->get();
+        if (!frame_info.valid) break;
+
+        straight_ctx.feed(frame_info.data, frame_info.time);
+        collect(straight_ctx, straight, 0);
+        if (frames < restart) {
+            before_ctx.feed(frame_info.data, frame_info.time);
+            delete before_ctx.get_processed_frame();
+        } else {
+            if (frames == restart) {
+                // Go through the file, as a restarted tracker would
+                TrackerState saved, loaded;
+                if (!before_ctx.get_state(saved) || !save_checkpoint(saved, checkpoint_name) || !load_checkpoint(loaded, checkpoint_name)) {
+                    cerr << "Cannot save and load the checkpoint" << endl;
+                    return 1;
+                }
+                resumed_ctx.resume(loaded);
+            }
+            resumed_ctx.feed(frame_info.data, frame_info.time);
+            collect(resumed_ctx, resumed, 0);
+            scratch_ctx.feed(frame_info.data, frame_info.time);
+            collect(scratch_ctx, scratch, restart);
+        }
+        frames++;
+    }
+    delete f;
+    remove(checkpoint_name.c_str());
+
+    cerr << "Frames: " << frames << endl;
+    if (frames <= restart) return 1;
+    int matches, compared;
+    int resumed_frames = compare(straight, resumed, restart, tolerance, matches, compared);
+    cerr << "Resumed from the checkpoint: " << matches << " of " << compared << " frames match, all of them after "
+         << resumed_frames << " frames" << endl;
+    bool ok = compared > 0 && resumed_frames == 0;
+    int scratch_frames = compare(straight, scratch, restart, tolerance, matches, compared);
+    cerr << "Started from scratch: " << matches << " of " << compared << " frames match, all of them after "
+         << scratch_frames << " frames" << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include <iostream>
+#include <chrono>
+
+#include "subotto_metrics.hpp"
+#include "control.hpp"
+#include "analysis.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// Compare the tabulated ball color model with the float computation
+// on random table frames, both for accuracy and for speed
+int main(int argc, char* argv[]) {
+    Size size(400, 240);
+    int frames = 100;
+    if (argc >= 3) {
+        size = Size(atoi(argv[1]), atoi(argv[2]));
+    }
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    BallDescription ball;
+    TableAnalysis table_analysis;
+    table_analysis.nll = Mat(size, CV_32F, Scalar(0.0));
+    ColorLUTCache lut;
+    BallAnalysis float_analysis, lut_analysis;
+    Mat float_density, lut_density;
+    Mat frame(size, CV_32FC3);
+
+    double float_time = 0.0, lut_time = 0.0, max_error = 0.0;
+    for (int i = 0; i < frames; i++) {
+        randu(frame, Scalar::all(0.0), Scalar::all(1.0));
+
+        auto begin = steady_clock::now();
+        do_ball_analysis(panel, frame, ball, table_analysis, float_analysis, float_density);
+        auto middle = steady_clock::now();
+        do_ball_analysis(panel, frame, ball, table_analysis, lut_analysis, lut_density, 1, &lut);
+        auto end = steady_clock::now();
+
+        float_time += duration_cast< duration< double, milli > >(middle - begin).count();
+        lut_time += duration_cast< duration< double, milli > >(end - middle).count();
+        Mat diff;
+        absdiff(float_analysis.ll, lut_analysis.ll, diff);
+        double frame_max;
+        minMaxLoc(diff, NULL, &frame_max);
+        max_error = max(max_error, frame_max);
+    }
+
+    // The first lookup pays for building the table
+    cerr << "Float ball analysis: " << float_time / frames << "ms per frame" << endl;
+    cerr << "Table ball analysis: " << lut_time / frames << "ms per frame" << endl;
+    cerr << "Max ball LL error: " << max_error << endl;
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <chrono>
+
+#include "subotto_metrics.hpp"
+#include "control.hpp"
+#include "analysis.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// The foosmen distance as do_foosmen_analysis() used to compute it:
+// 6-channel scatter, transform(), threshold() and then blur()
+static void reference_distance_blur(const Mat &slice, const foosmen_params_t& params, int side, Size ksize, Mat &out) {
+    Mat diff = slice - params.mean_color[side];
+
+    vector< Mat > inBGR;
+    split(diff, inBGR);
+    vector< Mat > outSplit;
+    for (int i = 0; i < 3; i++) {
+        outSplit.push_back(inBGR[i].mul(inBGR[i]));
+    }
+    for (int i = 0; i < 3; i++) {
+        outSplit.push_back(inBGR[i].mul(inBGR[(i+1)%3]));
+    }
+    Mat scatter;
+    merge(outSplit, scatter);
+
+    Mat distance, distanceTresh;
+    transform(scatter, distance, params.color_precision[side]);
+    threshold(distance, distanceTresh, params.nll_threshold, 0, THRESH_TRUNC);
+
+    blur(distanceTresh, out, ksize);
+}
+
+// Compare the fused foosmen kernel with the OpenCV version on random
+// bar slices, for both sides, for accuracy and for speed; then compare
+// it with the blur of the foosmen planes of do_classify_pixels() on the
+// columns of bars at the edges and in the middle of a table frame
+int main(int argc, char* argv[]) {
+    Size size(70, 240);
+    Size ksize(20, 8);
+    int iterations = 200;
+    if (argc >= 3) {
+        size = Size(atoi(argv[1]), atoi(argv[2]));
+    }
+
+    foosmen_params_t params;
+    Mat slice(size, CV_32FC3);
+    Mat reference, fused;
+
+    double reference_time = 0.0, fused_time = 0.0, max_error = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        int side = i % 2;
+        randu(slice, Scalar::all(0.0), Scalar::all(1.0));
+
+        auto begin = steady_clock::now();
+        reference_distance_blur(slice, params, side, ksize, reference);
+        auto middle = steady_clock::now();
+        foosmen_distance_blur(slice, params, side, ksize, fused);
+        auto end = steady_clock::now();
+
+        reference_time += duration_cast< duration< double, milli > >(middle - begin).count();
+        fused_time += duration_cast< duration< double, milli > >(end - middle).count();
+        Mat diff;
+        absdiff(reference, fused, diff);
+        double iteration_max;
+        minMaxLoc(diff, NULL, &iteration_max);
+        max_error = max(max_error, iteration_max);
+    }
+
+    cerr << "OpenCV foosmen distance: " << reference_time / iterations << "ms per slice" << endl;
+    cerr << "Fused foosmen distance: " << fused_time / iterations << "ms per slice" << endl;
+    cerr << "Max error: " << max_error << endl;
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    Mat frame(size.height, 4 * size.width, CV_32FC3);
+    randu(frame, Scalar::all(0.0), Scalar::all(1.0));
+    TableDescription table(frame.size());
+    TableAnalysis table_analysis;
+    PixelClasses classes;
+    do_classify_pixels(panel, frame, table, BallDescription(), params, table_analysis, classes);
+    double max_plane_error = 0.0;
+    for (int side = 0; side < 2; side++) {
+        for (int start : {0, size.width, 3 * size.width}) {
+            Range cols(start, start + size.width);
+            Mat plane_blur, diff;
+            foosmen_plane_blur(classes.plane(FOOSMEN_CLASS + side)(Range::all(), cols), ksize, plane_blur);
+            foosmen_distance_blur(frame(Range::all(), cols), params, side, ksize, fused);
+            absdiff(plane_blur, fused, diff);
+            double slice_max;
+            minMaxLoc(diff, NULL, &slice_max);
+            max_plane_error = max(max_plane_error, slice_max);
+        }
+    }
+    cerr << "Max error of the classified planes: " << max_plane_error << endl;
+
+    return max_error < 1e-4 && max_plane_error < 1e-4 ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "subotto_metrics.hpp"
+#include "control.hpp"
+#include "analysis.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// The mask as FrameAnalysis::draw_foosmen_mask() used to draw it
+// (with the corners rounded from the center), followed by the pixel
+// by pixel update of do_update_table_description()
+static void mask_update(const Mat &frame, const float shifts[BARS][2], const SubottoMetrics &metrics, const FoosmenMetrics &foosmenMetrics, Mat &mask, Mat &mean) {
+    mask = Mat(frame.size(), CV_8UC1, Scalar(255));
+    for(int side = 0; side < 2; side++) {
+        for(int bar = 0; bar < BARS; bar++) {
+            float xx = barx(side, bar, mask.size(), metrics, foosmenMetrics);
+            for(int i = 0; i < foosmenMetrics.count[bar]; i++) {
+                float y = (0.5f + i - foosmenMetrics.count[bar] * 0.5f) * foosmenMetrics.distance[bar];
+                float yy = (0.5f + (y + shifts[bar][side]) / metrics.width) * mask.rows;
+                rectangle(mask, Point(cvRound(xx) - 20, cvRound(yy) - 15), Point(cvRound(xx) + 20, cvRound(yy) + 15), Scalar(0), CV_FILLED);
+            }
+        }
+    }
+
+    for (int y = 0; y < frame.rows; y++) {
+        const float *frameRow = frame.ptr< float >(y);
+        const uint8_t *maskRow = mask.ptr< uint8_t >(y);
+        float *meanRow = mean.ptr< float >(y);
+        for (int x = 0; x < frame.cols; x++) {
+            if (maskRow[x] == 0) continue;
+            for (int c = 0; c < 3; c++) {
+                meanRow[3 * x + c] = 0.995f * meanRow[3 * x + c] + 0.005f * frameRow[3 * x + c];
+            }
+        }
+    }
+}
+
+static void stamps_update(const Mat &frame, const float shifts[BARS][2], const SubottoMetrics &metrics, const FoosmenMask &stamps, Mat &mean) {
+    FoosmenMask mask = stamps;
+    for(int side = 0; side < 2; side++) {
+        for(int bar = 0; bar < BARS; bar++) {
+            mask.set_shift(side * BARS + bar, shifts[bar][side] / metrics.width * frame.rows);
+        }
+    }
+
+    vector< Range > spans;
+    for (int y = 0; y < frame.rows; y++) {
+        const float *frameRow = frame.ptr< float >(y);
+        float *meanRow = mean.ptr< float >(y);
+        mask.for_each_run(y, frame.cols, spans, [&](int start, int end, bool masked) {
+            if (masked) return;
+            for (int i = 3 * start; i < 3 * end; i++) {
+                meanRow[i] = 0.995f * meanRow[i] + 0.005f * frameRow[i];
+            }
+        });
+    }
+}
+
+// Update a background with random frames and random bar shifts, once
+// with the rasterized mask and once with the stamps, and check that
+// the masks and the backgrounds are the same
+int main(int argc, char* argv[]) {
+    Size size(400, 240);
+    int frames = 500;
+    if (argc >= 3) {
+        size = Size(atoi(argv[1]), atoi(argv[2]));
+    }
+
+    SubottoMetrics metrics;
+    FoosmenMetrics foosmenMetrics;
+    FoosmenMask stamps;
+    init_foosmen_mask(stamps, size, metrics, foosmenMetrics);
+
+    RNG rng(2718);
+    Mat frame(size, CV_32FC3);
+    Mat mask_mean(size, CV_32FC3, Scalar::all(0.5)), stamps_mean = mask_mean.clone();
+    double mask_time = 0.0, stamps_time = 0.0;
+    int mask_mismatches = 0;
+    for (int i = 0; i < frames; i++) {
+        randu(frame, Scalar::all(0.0), Scalar::all(1.0));
+        float shifts[BARS][2];
+        for(int side = 0; side < 2; side++) {
+            for(int bar = 0; bar < BARS; bar++) {
+                shifts[bar][side] = rng.uniform(-0.15f, 0.15f);
+            }
+        }
+
+        Mat mask;
+        auto begin = steady_clock::now();
+        mask_update(frame, shifts, metrics, foosmenMetrics, mask, mask_mean);
+        auto middle = steady_clock::now();
+        stamps_update(frame, shifts, metrics, stamps, stamps_mean);
+        auto end = steady_clock::now();
+
+        mask_time += duration_cast< duration< double, milli > >(middle - begin).count();
+        stamps_time += duration_cast< duration< double, milli > >(end - middle).count();
+
+        FoosmenMask shifted = stamps;
+        for(int side = 0; side < 2; side++) {
+            for(int bar = 0; bar < BARS; bar++) {
+                shifted.set_shift(side * BARS + bar, shifts[bar][side] / metrics.width * size.height);
+            }
+        }
+        Mat drawn;
+        shifted.draw(drawn, size);
+        mask_mismatches += norm(drawn, mask, NORM_INF) > 0.0;
+    }
+
+    double max_error = norm(mask_mean, stamps_mean, NORM_INF);
+    cerr << "Rasterized mask: " << mask_time / frames << "ms per frame" << endl;
+    cerr << "Foosmen stamps: " << stamps_time / frames << "ms per frame" << endl;
+    cerr << "Mask mismatches: " << mask_mismatches << ", background max error: " << max_error << endl;
+
+    return mask_mismatches == 0 && max_error == 0.0 ? 0 : 1;
+}
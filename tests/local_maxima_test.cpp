@@ -0,0 +1,89 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "local_maxima.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+typedef pair< Point, float > maximum_t;
+
+// The dilate based search that find_top_local_maxima() replaces; the
+// maxima are fully sorted, in the same order, so that the two results
+// can be compared
+static vector< maximum_t > dilate_local_maxima(const Mat &density, int radiusX, int radiusY, int limit) {
+    Mat dilatedDensity;
+    dilate(density, dilatedDensity, Mat::ones(2 * radiusY + 1, 2 * radiusX + 1, CV_8U));
+
+    Mat localMaxMask = (density >= dilatedDensity);
+
+    vector< Point > nonZero;
+    findNonZero(localMaxMask, nonZero);
+
+    vector< maximum_t > localMaxima;
+    for (const auto &p : nonZero) {
+        localMaxima.push_back(make_pair(p, density.at< float >(p)));
+    }
+
+    // findNonZero() goes by rows, so a stable sort keeps ties in the
+    // same order
+    stable_sort(localMaxima.begin(), localMaxima.end(), [](const maximum_t &a, const maximum_t &b) {
+        return a.second > b.second;
+    });
+    localMaxima.resize(min(localMaxima.size(), size_t(limit)));
+
+    return localMaxima;
+}
+
+// Compare the two searches on random smooth densities, with values
+// rounded so that plateaus and ties happen, for a range of radii
+int main(int argc, char* argv[]) {
+    Size size(400, 240);
+    int frames = 50;
+    int limit = 5;
+    if (argc >= 3) {
+        size = Size(atoi(argv[1]), atoi(argv[2]));
+    }
+
+    vector< int > radii = { 0, 1, 2, 3, 5, 8, 12, 20, 35 };
+    bool ok = true;
+    RNG rng(1234);
+    for (int radius : radii) {
+        int radiusX = radius;
+        int radiusY = radius * 3 / 5;
+        double dilate_time = 0.0, top_time = 0.0;
+        int mismatches = 0;
+
+        for (int i = 0; i < frames; i++) {
+            Mat noise(size, CV_32F), density;
+            rng.fill(noise, RNG::NORMAL, 0.0, 10.0);
+            GaussianBlur(noise, density, Size(0, 0), 1.0 + i % 4);
+            density.convertTo(density, CV_16S, 10.0);
+            density.convertTo(density, CV_32F, 0.1);
+
+            auto begin = steady_clock::now();
+            auto expected = dilate_local_maxima(density, radiusX, radiusY, limit);
+            auto middle = steady_clock::now();
+            auto found = find_top_local_maxima(density, radiusX, radiusY, limit);
+            auto end = steady_clock::now();
+
+            dilate_time += duration_cast< duration< double, milli > >(middle - begin).count();
+            top_time += duration_cast< duration< double, milli > >(end - middle).count();
+            if (found != expected) {
+                mismatches++;
+            }
+        }
+
+        cerr << "Radius " << radiusX << "x" << radiusY << ": dilate " << dilate_time / frames
+             << "ms, top-K " << top_time / frames << "ms per frame, "
+             << mismatches << " mismatches" << endl;
+        ok = ok && mismatches == 0;
+    }
+    cerr << (ok ? "Local maxima match" : "Local maxima DO NOT match") << endl;
+
+    return ok ? 0 : 1;
+}
@@ -1,29 +1,72 @@
 #include <stdio.h>
 #include <iostream>
 #include <vector>
-#include "median.hpp"
+#include <chrono>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "median_background.hpp"
 
 using namespace cv;
 using namespace std;
+using namespace chrono;
 
+// Feed the frames of a video, resized to table frame size, to both
+// the background models and compare their running times
 int main(int argc, char** argv) {
+    if(argc < 2) {
+        cerr << "Usage: " << argv[0] << " <video> [<width> <height>]" << endl;
+        exit(EXIT_FAILURE);
+    }
     VideoCapture capture(argv[1]);
     if(!capture.isOpened()){
         cerr << "Unable to open video file:" << argv[1] << endl;
         exit(EXIT_FAILURE);
     }
+    Size size(400, 240);
+    if(argc >= 4) {
+        size = Size(atoi(argv[2]), atoi(argv[3]));
+    }
     namedWindow("Frame", WINDOW_NORMAL);
     namedWindow("Median", WINDOW_NORMAL);
-    Mat frame;
-    MedianComputer mc(240, 320);
+    namedWindow("Mean", WINDOW_NORMAL);
+    Mat frame, table_frame, scatter;
+    Mat median(size, CV_32FC3, Scalar(135.0/255.0, 150.0/255.0, 120.0/255.0));
+    Mat mean = median.clone();
+    Mat variance(size, CV_32FC3, Scalar::all(0.0));
+    MedianBackground mc(size);
+    double median_time = 0.0, mean_time = 0.0;
+    int frames = 0;
     while(waitKey(1) != 'e') {
         if(!capture.read(frame)) {
             cerr << "Video end." << endl;
             break;
         }
-        mc.update(frame);
-        imshow("Frame", frame);
-        imshow("Median", mc.getMedian());
+        resize(frame, table_frame, size);
+        table_frame.convertTo(table_frame, CV_32F, 1 / 255.f);
+
+        auto begin = steady_clock::now();
+        mc.update(table_frame, NULL, median);
+        auto middle = steady_clock::now();
+        Mat diff = table_frame - mean;
+        accumulateWeighted(table_frame, mean, 0.005f);
+        multiply(diff, diff, scatter);
+        accumulateWeighted(scatter, variance, 0.005f);
+        auto end = steady_clock::now();
+
+        median_time += duration_cast< duration< double, milli > >(middle - begin).count();
+        mean_time += duration_cast< duration< double, milli > >(end - middle).count();
+        frames++;
+
+        imshow("Frame", table_frame);
+        imshow("Median", median);
+        imshow("Mean", mean);
+    }
+    if(frames > 0) {
+        cerr << "Frames: " << frames << endl;
+        cerr << "Running median: " << median_time / frames << "ms per frame" << endl;
+        cerr << "Running average: " << mean_time / frames << "ms per frame" << endl;
     }
     cerr << "Capture ended" << endl;
     destroyAllWindows();
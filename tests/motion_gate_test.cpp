@@ -0,0 +1,107 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "context.hpp"
+#include "half_float.hpp"
+#include "staging.hpp"
+#include "utility.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// Analyze a recording with and without the motion gate, timing the
+// analysis and checking that the gated one finds the same ball spots
+// (up to a pixel) and about the same bar shifts, and that it learns
+// about the same background
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        cerr << "Usage: " << argv[0] << " <video> <reference subotto> [<reference subotto mask>]" << endl;
+        return 1;
+    }
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    Mat ref_frame = imread(argv[2]);
+    Mat ref_mask;
+    if (argc == 4) {
+        ref_mask = imread(argv[3], CV_LOAD_IMAGE_GRAYSCALE);
+    }
+
+    // The ungated context warps the 8-bit frame too, so that the two
+    // table frames are the same
+    SubtrackerContext full_ctx(ref_frame, ref_mask, panel, true);
+    SubtrackerContext gated_ctx(ref_frame, ref_mask, panel, true);
+    full_ctx.frame_settings.motion_gate.enabled = true;
+    full_ctx.frame_settings.motion_gate.refresh_interval = 1;
+    gated_ctx.frame_settings.motion_gate.enabled = true;
+    const FrameSettings &settings = full_ctx.frame_settings;
+    double tolerance = settings.table_metrics.length / settings.table_frame_size.width;
+
+    double full_time = 0.0, gated_time = 0.0, max_shift_error = 0.0;
+    double max_mean_error = 0.0, max_variance_error = 0.0;
+    int frames = 0, spots = 0, matched_spots = 0;
+    auto f = open_frame_cycle(argv[1], panel);
+    f->start();
+    while (true) {
+        auto frame_info = f->get();
+        if (!frame_info.valid) break;
+
+        auto begin = steady_clock::now();
+        full_ctx.feed(frame_info.data, frame_info.time);
+        auto middle = steady_clock::now();
+        gated_ctx.feed(frame_info.data, frame_info.time);
+        auto end = steady_clock::now();
+        full_time += duration_cast< duration< double, milli > >(middle - begin).count();
+        gated_time += duration_cast< duration< double, milli > >(end - middle).count();
+
+        FrameAnalysis *full = full_ctx.get_processed_frame();
+        FrameAnalysis *gated = gated_ctx.get_processed_frame();
+        if (full == NULL || gated == NULL) {
+            delete full;
+            delete gated;
+            continue;
+        }
+
+        for (const auto &spot : full->spots) {
+            double distance = INFINITY;
+            for (const auto &other : gated->spots) {
+                distance = min(distance, double(norm(spot.center - other.center)));
+            }
+            spots++;
+            matched_spots += distance <= tolerance;
+        }
+        for (int side = 0; side < 2; side++) {
+            for (int bar = 0; bar < BARS; bar++) {
+                max_shift_error = max(max_shift_error, double(fabs(full->bars_shift[bar][side] - gated->bars_shift[bar][side])));
+            }
+        }
+        // Idle frames still feed the background
+        auto map_error = [](const Mat &a, const Mat &b) {
+            Mat float_a, float_b, diff;
+            load_map(a, float_a);
+            load_map(b, float_b);
+            absdiff(float_a, float_b, diff);
+            return mean(diff.reshape(1))[0];
+        };
+        max_mean_error = max(max_mean_error, map_error(full->table_description.mean, gated->table_description.mean));
+        max_variance_error = max(max_variance_error, map_error(full->table_description.variance, gated->table_description.variance));
+        frames++;
+        delete full;
+        delete gated;
+    }
+    delete f;
+
+    cerr << "Frames: " << frames << endl;
+    if (frames == 0) return 1;
+    cerr << "Full analysis: " << full_time / frames << "ms per frame" << endl;
+    cerr << "Gated analysis: " << gated_time / frames << "ms per frame, fraction of tiles skipped " << gated_ctx.motion_gate.get_skipped_fraction()
+         << ", idle frames " << gated_ctx.motion_gate.get_idle_frames() << endl;
+    cerr << "Spots found by both: " << matched_spots << " of " << spots << ", max bar shift difference " << max_shift_error << "m" << endl;
+    cerr << "Max mean background difference: " << max_mean_error << " in the mean, " << max_variance_error << " in the variance" << endl;
+
+    return max_mean_error <= 1.0 / 255.0 && max_variance_error <= 1e-4 ? 0 : 1;
+}
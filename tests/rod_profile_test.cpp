@@ -0,0 +1,192 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <limits>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "rod_profile.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+static double elapsed(steady_clock::time_point &begin) {
+    auto end = steady_clock::now();
+    double res = duration_cast< duration< double, milli > >(end - begin).count();
+    begin = end;
+    return res;
+}
+
+// The Qt estimator before comb_correlation(): the profile is translated
+// with warpAffine() once per foosman and summed up
+static int warp_rod_shift(const Mat &profile, int num, double translation_len) {
+    Mat replicated = profile.clone();
+    for (int i = 1; i < num; i++) {
+        Mat translated;
+        Mat trans_mat = Mat(Matx< float, 2, 3 >(1.0, 0.0, 0.0, 0.0, 1.0, i * translation_len));
+        warpAffine(profile, translated, trans_mat, profile.size(), INTER_LINEAR | WARP_INVERSE_MAP, BORDER_CONSTANT, Scalar(numeric_limits< float >::lowest()));
+        replicated += translated;
+    }
+    replicated /= num;
+    Point max_point;
+    minMaxLoc(replicated, NULL, NULL, NULL, &max_point);
+    return max_point.y;
+}
+
+static int comb_rod_shift(const Mat &profile, int num, double translation_len) {
+    vector< float > offsets;
+    for (int i = 0; i < num; i++) {
+        offsets.push_back(i * translation_len);
+    }
+    vector< float > correlation(profile.rows);
+    comb_correlation(profile.ptr< float >(), profile.rows, offsets, -numeric_limits< float >::infinity(), correlation.data(), correlation.size());
+    return max_element(correlation.begin(), correlation.end()) - correlation.begin();
+}
+
+// The cpp estimator before comb_correlation(): the marginPixels rows
+// around each foosman are summed up in a 2-D strip, whose minimum
+// gives the shift (row) and the rotation (column)
+static Point overlapped_minimum(const Mat &nll, const vector< int > &offsets, int margin) {
+    Mat overlapped(margin, nll.cols, CV_32F, Scalar(0.f));
+    for (int offset : offsets) {
+        overlapped += nll.rowRange(offset, offset + margin);
+    }
+    Point m;
+    minMaxLoc(overlapped, NULL, NULL, &m, NULL);
+    return m;
+}
+
+static Point projection_minimum(const Mat &nll, const vector< int > &offsets, int margin) {
+    Mat profile;
+    reduce(nll, profile, 1, REDUCE_SUM);
+    vector< float > comb(offsets.begin(), offsets.end());
+    vector< float > correlation(margin);
+    comb_correlation(profile.ptr< float >(), profile.rows, comb, numeric_limits< float >::infinity(), correlation.data(), margin);
+    int y = min_element(correlation.begin(), correlation.end()) - correlation.begin();
+
+    vector< float > row(nll.cols, 0.f);
+    for (int offset : offsets) {
+        const float *nll_row = nll.ptr< float >(y + offset);
+        for (int x = 0; x < nll.cols; x++) {
+            row[x] += nll_row[x];
+        }
+    }
+    int x = min_element(row.begin(), row.end()) - row.begin();
+    return Point(x, y);
+}
+
+// Follow a rod moving back and forth (with a few jumps) with and
+// without the prediction, and check that they find the same shifts
+static bool test_prediction(RNG &rng, int rows, int frames) {
+    int num = 3;
+    float distance = rows * 0.25f;
+    vector< float > offsets;
+    for (int i = 0; i < num; i++) {
+        offsets.push_back(i * distance);
+    }
+    int n = rows - (num - 1) * distance;
+
+    rod_search_params_t full_params, predict_params;
+    predict_params.predict = true;
+    rod_prediction_t full_state, predict_state;
+    double full_time = 0.0, predict_time = 0.0;
+    int same = 0;
+    vector< float > profile(rows);
+    for (int frame = 0; frame < frames; frame++) {
+        float position = n * (0.5f + 0.4f * sin(frame * 0.03f));
+        if (frame % 500 == 250) {
+            position = rng.uniform(0.f, float(n - 1));
+        }
+        for (int y = 0; y < rows; y++) {
+            profile[y] = rng.uniform(0.f, 0.2f);
+            for (float offset : offsets) {
+                float d = y - position - offset;
+                profile[y] += exp(-d * d / 8.f);
+            }
+        }
+
+        auto begin = steady_clock::now();
+        float full = search_rod_shift(profile.data(), rows, offsets, n, true, full_params, full_state);
+        full_time += elapsed(begin);
+        float predicted = search_rod_shift(profile.data(), rows, offsets, n, true, predict_params, predict_state);
+        predict_time += elapsed(begin);
+        same += abs(full - predicted) < 1e-3;
+    }
+
+    cerr << "Moving rod: full search " << full_time / frames << "ms, predicted search " << predict_time / frames
+         << "ms, fraction of shifts searched " << predict_state.searched_fraction()
+         << ", fallback rate " << predict_state.fallback_rate()
+         << ", same shift " << same << " of " << frames << endl;
+    return same == frames;
+}
+
+// Compare the 1-D rod shift estimators with the ones they replace, on
+// random strips with a bright (Qt) or dark (cpp) spot for each foosman
+int main(int argc, char* argv[]) {
+    int rows = 240;
+    int cols = 40;
+    int iterations = 500;
+    if (argc >= 3) {
+        cols = atoi(argv[1]);
+        rows = atoi(argv[2]);
+    }
+
+    RNG rng(4321);
+    vector< int > counts = { 1, 2, 3, 5 };
+    bool ok = true;
+    for (int num : counts) {
+        double distance = num > 1 ? rows * 0.6 / (num - 1) + rng.uniform(0.0, 1.0) : 0.0;
+        int margin = rows - (num - 1) * distance;
+        double time[4] = { 0.0, 0.0, 0.0, 0.0 };
+        int same_qt = 0, same_shift = 0, same_rot = 0;
+
+        for (int it = 0; it < iterations; it++) {
+            int shift = rng.uniform(0, margin);
+            int column = rng.uniform(0, cols);
+            Mat strip(rows, cols, CV_32F);
+            rng.fill(strip, RNG::UNIFORM, 0.0, 1.0);
+            for (int i = 0; i < num; i++) {
+                int y = shift + int(i * distance);
+                if (y < rows) {
+                    circle(strip, Point(column, y), 3, Scalar(-3.0), -1);
+                }
+            }
+            blur(strip, strip, Size(5, 5));
+
+            // The Qt profile is the (bright) average of the strip
+            Mat profile;
+            reduce(-strip, profile, 1, REDUCE_AVG);
+            auto begin = steady_clock::now();
+            int warp_y = warp_rod_shift(profile, num, distance);
+            time[0] += elapsed(begin);
+            int comb_y = comb_rod_shift(profile, num, distance);
+            time[1] += elapsed(begin);
+            same_qt += warp_y == comb_y;
+
+            vector< int > offsets;
+            for (int i = 0; i < num; i++) {
+                offsets.push_back(int(i * distance));
+            }
+            begin = steady_clock::now();
+            Point overlapped = overlapped_minimum(strip, offsets, margin);
+            time[2] += elapsed(begin);
+            Point projection = projection_minimum(strip, offsets, margin);
+            time[3] += elapsed(begin);
+            same_shift += abs(overlapped.y - projection.y) <= 1;
+            same_rot += abs(overlapped.x - projection.x) <= 1;
+        }
+
+        cerr << num << " foosmen: Qt warpAffine " << time[0] / iterations << "ms, comb " << time[1] / iterations
+             << "ms, same shift " << same_qt << " of " << iterations << endl;
+        cerr << "\tcpp overlapped " << time[2] / iterations << "ms, projection " << time[3] / iterations
+             << "ms, shift within a pixel " << same_shift << ", rotation within a pixel " << same_rot << " of " << iterations << endl;
+        // warpAffine() interpolates with 1/32 pixel weights, so a few
+        // ties may be broken the other way
+        ok = ok && same_qt >= iterations * 0.95;
+    }
+    ok = test_prediction(rng, rows, iterations * 4) && ok;
+    cerr << (ok ? "Rod shift estimators match" : "Rod shift estimators DO NOT match") << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "context.hpp"
+#include "utility.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// Track the ball spots of a recording with the full tracker and with
+// the beam search, timing both and counting the frames where they give
+// the same position
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 5) {
+        cerr << "Usage: " << argv[0] << " <video> <reference subotto> [<reference subotto mask> [<beam width>]]" << endl;
+        return 1;
+    }
+    int beam_width = argc >= 5 ? atoi(argv[4]) : 8;
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    Mat ref_frame = imread(argv[2]);
+    Mat ref_mask;
+    if (argc >= 4) {
+        ref_mask = imread(argv[3], CV_LOAD_IMAGE_GRAYSCALE);
+    }
+
+    // The context only searches the spots, the trackers are fed here
+    SubtrackerContext ctx(ref_frame, ref_mask, panel, true);
+    SpotsTracker full(panel), beamed(panel);
+    beamed.set_beam(beam_width);
+    int span = ctx.spots_timeline_span;
+
+    double full_time = 0.0, beamed_time = 0.0;
+    int frames = 0, committed = 0, agreements = 0;
+    auto f = open_frame_cycle(argv[1], panel);
+    f->start();
+    while (true) {
+        auto frame_info = f->get();
+        if (!frame_info.valid) break;
+        ctx.feed(frame_info.data, frame_info.time);
+
+        FrameAnalysis *frame_analysis;
+        while ((frame_analysis = ctx.get_processed_frame()) != NULL) {
+            double time = ctx.get_time(*frame_analysis);
+            auto begin = steady_clock::now();
+            full.push_back(frame_analysis->spots, time);
+            auto middle = steady_clock::now();
+            beamed.push_back(frame_analysis->spots, time);
+            auto end = steady_clock::now();
+            full_time += duration_cast< duration< double, milli > >(middle - begin).count();
+            beamed_time += duration_cast< duration< double, milli > >(end - middle).count();
+
+            if (frames >= span) {
+                bool full_valid, beamed_valid;
+                Point2f full_position, beamed_position;
+                tie(full_valid, full_position) = full.front();
+                tie(beamed_valid, beamed_position) = beamed.front();
+                full.pop_front();
+                beamed.pop_front();
+                committed++;
+                agreements += full_valid == beamed_valid && (!full_valid || full_position == beamed_position);
+            }
+            frames++;
+            delete frame_analysis;
+        }
+    }
+    delete f;
+
+    cerr << "Frames: " << frames << endl;
+    if (committed == 0) return 1;
+    cerr << "Full tracker: " << full_time / frames << "ms per frame" << endl;
+    cerr << "Beam of " << beam_width << ": " << beamed_time / frames << "ms per frame" << endl;
+    cerr << "Frames where they agree: " << agreements << " of " << committed << endl;
+
+    return 0;
+}
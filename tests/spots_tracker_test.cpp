@@ -0,0 +1,462 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#include "spots_tracker.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// The exhaustive search on a deque of frames that SpotsTracker
+// replaces, with its default parameters: every new node looks at every
+// node of the frames of the last half second, up to 120 of them
+class BruteSpotsTracker {
+public:
+    BruteSpotsTracker() {
+        node_t phantom_node = {SpotNode(Spot({0.0, 0.0}, 0.0), 0.0, -1, false), 0.0, -1, 0};
+        this->frames.push_back(vector< node_t >(1, phantom_node));
+    }
+
+    void push_back(const vector< Spot > &spots, double time) {
+        if (this->node_num == 0) {
+            this->frames.front().front().node.time = time;
+        }
+
+        vector< node_t > v;
+        for (auto spot : spots) {
+            v.push_back({SpotNode(spot, time, this->node_num, true), 1e100, 0, 0});
+        }
+        v.push_back({SpotNode(Spot({0.0, 0.0}, 0.0), time, this->node_num, false), 1e100, 0, 0});
+        this->node_num++;
+
+        // Frame num is at num + 1
+        long int end = this->frames.size();
+        long int begin = max< long int >(0, end - 120);
+        while (begin < end - 1 && time - this->frames[begin].front().node.time > 0.5) {
+            begin++;
+        }
+        double back_badness = 1e100;
+        for (int k = 0; k < v.size(); k++) {
+            node_t &n2 = v[k];
+            for (long int i = begin; i < end; i++) {
+                for (int j = 0; j < this->frames[i].size(); j++) {
+                    const node_t &n1 = this->frames[i][j];
+                    bool legal_jump;
+                    double delta_badness;
+                    tie(legal_jump, delta_badness) = jump_badness(n1.node, n2.node);
+                    if (!legal_jump) continue;
+                    double new_badness = n1.badness + delta_badness;
+                    if (new_badness < n2.badness) {
+                        n2.badness = new_badness;
+                        n2.prev_num = n1.node.num;
+                        n2.prev_index = j;
+                    }
+                }
+            }
+            if (n2.badness < back_badness) {
+                back_badness = n2.badness;
+                this->back_best = k;
+            }
+        }
+        this->frames.push_back(v);
+    }
+
+    // Same as SpotsTracker::front() followed by pop_front(); popped
+    // frames are kept, so that the links can be followed
+    tuple< bool, Point2f > pop_front() {
+        if (this->front_num == -1) this->front_num++;
+        const node_t *ret = &this->get(this->node_num - 1, this->back_best);
+        while (ret->prev_num > this->front_num) {
+            ret = &this->get(ret->prev_num, ret->prev_index);
+        }
+        const SpotNode &node = ret->node;
+        const SpotNode &prev = this->get(ret->prev_num, ret->prev_index).node;
+        tuple< bool, Point2f > result;
+        if (prev.num == this->front_num) {
+            result = make_tuple(prev.present, prev.spot.center);
+        } else if (node.num == this->front_num) {
+            result = make_tuple(node.present, node.spot.center);
+        } else if (node.present && prev.present) {
+            double t1 = (this->get(this->front_num, 0).node.time - prev.time) / (node.time - prev.time);
+            result = make_tuple(true, Point2f((1 - t1) * prev.spot.center + t1 * node.spot.center));
+        } else {
+            result = make_tuple(false, node.spot.center);
+        }
+        this->front_num++;
+        return result;
+    }
+
+private:
+    struct node_t {
+        SpotNode node;
+        double badness;
+        int prev_num, prev_index;
+    };
+
+    // All the frames since the phantom one, popped ones included
+    deque< vector< node_t > > frames;
+    int back_best = 0;
+    int node_num = 0;
+    int front_num = -1;
+
+    const node_t &get(int num, int index) const {
+        return this->frames[num + 1][index];
+    }
+
+    tuple< bool, double > jump_badness(const SpotNode &n1, const SpotNode &n2) const {
+        double ret = 0.0;
+        double time = n2.time - n1.time;
+        double skip = this->get(n2.num - 1, 0).node.time - n1.time;
+        if (n1.present && !n2.present) {
+            ret += 400.0;
+        } else if (!n1.present && n2.present) {
+            ret += 400.0;
+        } else if (!n1.present && !n2.present) {
+            ret += -10.0;
+            if (n2.num - n1.num > 1) return make_tuple(false, 0.0);
+        }
+        if (n2.present) {
+            ret -= n2.spot.weight;
+        }
+        ret += skip * -960.0;
+        if (n1.present && n2.present) {
+            double distance = norm(n1.spot.center - n2.spot.center);
+            if (distance > 18.0 * time) return make_tuple(false, 0.0);
+            if (distance > 0.3) return make_tuple(false, 0.0);
+            ret += distance * distance / (time * 0.3);
+        }
+        return make_tuple(true, ret);
+    }
+};
+
+// Spots of a ball bouncing on the table at fps frames per second,
+// hidden from time to time, among random spots; or, on a lattice, spots with integer weights and
+// irregular frame times, so that many paths have the same badness and
+// the ties have to be broken in the same way too
+class SpotsGenerator {
+public:
+    SpotsGenerator(int limit, bool lattice, double fps = 120.0)
+        : rng(1618 + limit + lattice), limit(limit), lattice(lattice), fps(fps), ball(0.0f, 0.0f), speed(1.44f / fps, 0.84f / fps) {
+    }
+
+    vector< Spot > next(int i, double &time) {
+        vector< Spot > spots;
+        if (!this->lattice) {
+            this->ball += this->speed;
+            if (fabs(this->ball.x) > this->table.width / 2) this->speed.x = -this->speed.x;
+            if (fabs(this->ball.y) > this->table.height / 2) this->speed.y = -this->speed.y;
+            int count = this->limit;
+            if (int(i * 120.0 / this->fps) % 50 < 40) {
+                Point2f noise(this->rng.uniform(-0.005f, 0.005f), this->rng.uniform(-0.005f, 0.005f));
+                spots.push_back(Spot(this->ball + noise, this->rng.uniform(20.0, 40.0)));
+                count--;
+            }
+            for (int j = 0; j < count; j++) {
+                Point2f p(this->rng.uniform(-this->table.width / 2, this->table.width / 2), this->rng.uniform(-this->table.height / 2, this->table.height / 2));
+                spots.push_back(Spot(p, this->rng.uniform(0.0, 25.0)));
+            }
+            time = i / this->fps;
+        } else {
+            int count = this->rng.uniform(0, this->limit + 1);
+            for (int j = 0; j < count; j++) {
+                Point2f p(0.05f * this->rng.uniform(-11, 12), 0.05f * this->rng.uniform(-7, 8));
+                spots.push_back(Spot(p, this->rng.uniform(0, 25)));
+            }
+            time += this->rng.uniform(1, 4) / 120.0;
+        }
+        return spots;
+    }
+
+private:
+    RNG rng;
+    int limit;
+    bool lattice;
+    double fps;
+    Size2f table = Size2f(1.135f, 0.7f);
+    Point2f ball, speed;
+};
+
+// Run the tracker and the exhaustive search on the same spots, and
+// check that they give the same positions; then commit the frames as
+// soon as the tracker settles on them, and compare with the fixed span
+// and with the provisional positions; compare the beam search and the
+// fixed costs with the full tracker; finally resume a tracker from the
+// state of another one
+int main(int argc, char* argv[]) {
+    int frames = 600;
+    int span = 60;
+    if (argc >= 2) {
+        frames = atoi(argv[1]);
+    }
+    if (argc >= 3) {
+        span = atoi(argv[2]);
+    }
+
+    control_panel_t panel;
+    init_control_panel(panel);
+
+    bool ok = true;
+    for (bool lattice : {false, true}) for (int limit : {5, 10, 20, 50}) {
+        SpotsGenerator generator(limit, lattice);
+        SpotsTracker tracker(panel);
+        BruteSpotsTracker brute;
+        double tracker_time = 0.0, brute_time = 0.0;
+        int mismatches = 0;
+        double time = 0.0;
+
+        for (int i = 0; i < frames; i++) {
+            vector< Spot > spots = generator.next(i, time);
+
+            auto begin = steady_clock::now();
+            tracker.push_back(spots, time);
+            bool valid = false;
+            Point2f position;
+            if (i >= span) {
+                tie(valid, position) = tracker.front();
+                tracker.pop_front();
+            }
+            auto middle = steady_clock::now();
+            brute.push_back(spots, time);
+            bool expected_valid = false;
+            Point2f expected_position;
+            if (i >= span) {
+                tie(expected_valid, expected_position) = brute.pop_front();
+            }
+            auto end = steady_clock::now();
+
+            tracker_time += duration_cast< duration< double, milli > >(middle - begin).count();
+            brute_time += duration_cast< duration< double, milli > >(end - middle).count();
+            if (valid != expected_valid || (valid && position != expected_position)) {
+                mismatches++;
+            }
+        }
+
+        cerr << limit << (lattice ? " lattice" : "") << " spots per frame: exhaustive " << brute_time / frames
+             << "ms, tracker " << tracker_time / frames << "ms per frame, "
+             << mismatches << " mismatches" << endl;
+        ok = ok && mismatches == 0;
+    }
+    cerr << (ok ? "Tracks match" : "Tracks DO NOT match") << endl;
+
+    // A frame without spots only has its absent node, which trivially
+    // agrees with itself; the last frame must not be committed anyway
+    {
+        SpotsTracker early(panel);
+        double time = 0.0;
+        int committed = 0;
+        for (int count : {1, 1, 1, 0, 0, 1, 0}) {
+            vector< Spot > spots;
+            for (int j = 0; j < count; j++) {
+                spots.push_back(Spot(Point2f(0.01f * committed, 0.0f), 30.0));
+            }
+            time += 1.0 / 120.0;
+            early.push_back(spots, time);
+            while (early.front_settled()) {
+                early.front();
+                early.pop_front();
+                committed++;
+            }
+        }
+        ok = ok && early.get_front_num() < 7;
+        cerr << "Empty frames: " << committed << " of 7 frames committed early" << endl;
+    }
+
+    for (bool lattice : {false, true}) for (int limit : {5, 20, 50}) {
+        SpotsGenerator generator(limit, lattice);
+        SpotsTracker fixed(panel), early(panel);
+        vector< tuple< bool, Point2f > > fixed_positions, early_positions, provisional_positions;
+        double time = 0.0;
+        for (int i = 0; i < frames; i++) {
+            vector< Spot > spots = generator.next(i, time);
+            fixed.push_back(spots, time);
+            early.push_back(spots, time);
+            provisional_positions.push_back(fixed.back());
+            if (i >= span) {
+                fixed_positions.push_back(fixed.front());
+                fixed.pop_front();
+            }
+            while (int(early_positions.size()) < i + 1 - span || (early_positions.size() <= i && early.front_settled())) {
+                ok = ok && early.get_front_num() == int(early_positions.size());
+                early_positions.push_back(early.front());
+                early.pop_front();
+            }
+        }
+
+        auto differ = [](const tuple< bool, Point2f > &a, const tuple< bool, Point2f > &b) {
+            return get< 0 >(a) != get< 0 >(b) || (get< 0 >(a) && get< 1 >(a) != get< 1 >(b));
+        };
+        int differences = 0, corrections = 0;
+        for (size_t i = 0; i < fixed_positions.size(); i++) {
+            differences += differ(fixed_positions[i], early_positions[i]);
+            corrections += differ(fixed_positions[i], provisional_positions[i]);
+        }
+        cerr << limit << (lattice ? " lattice" : "") << " spots per frame, early commit latency in frames: mean " << early.get_mean_latency()
+             << ", median " << early.get_latency_percentile(0.5)
+             << ", 90th percentile " << early.get_latency_percentile(0.9)
+             << ", max " << early.get_latency_percentile(1.0)
+             << "; " << differences << " of " << fixed_positions.size() << " frames differ from the fixed span, "
+             << corrections << " provisional positions corrected" << endl;
+        ok = ok && early.get_latency_percentile(1.0) <= span && differences == 0;
+    }
+
+    // A beam wider than the frames changes nothing; narrower ones should
+    // still agree with the full tracker on most frames, in less time
+    for (int limit : {20, 50}) for (int beam : {0, 2, 4, 8, 16, 64}) {
+        SpotsGenerator generator(limit, false);
+        SpotsTracker full(panel), beamed(panel);
+        beamed.set_beam(beam);
+        double full_time = 0.0, beamed_time = 0.0;
+        int agreements = 0, committed = 0;
+        double time = 0.0;
+        for (int i = 0; i < frames; i++) {
+            vector< Spot > spots = generator.next(i, time);
+            auto begin = steady_clock::now();
+            full.push_back(spots, time);
+            tuple< bool, Point2f > full_position;
+            if (i >= span) {
+                full_position = full.front();
+                full.pop_front();
+            }
+            auto middle = steady_clock::now();
+            beamed.push_back(spots, time);
+            tuple< bool, Point2f > beamed_position;
+            if (i >= span) {
+                beamed_position = beamed.front();
+                beamed.pop_front();
+            }
+            auto end = steady_clock::now();
+            full_time += duration_cast< duration< double, milli > >(middle - begin).count();
+            beamed_time += duration_cast< duration< double, milli > >(end - middle).count();
+            if (i >= span) {
+                committed++;
+                agreements += get< 0 >(full_position) == get< 0 >(beamed_position) &&
+                    (!get< 0 >(full_position) || get< 1 >(full_position) == get< 1 >(beamed_position));
+            }
+        }
+        cerr << limit << " spots per frame, beam " << beam << ": full " << full_time / frames << "ms, beam "
+             << beamed_time / frames << "ms per frame, " << agreements << " of " << committed << " frames agree" << endl;
+        if (beam == 0 || beam == 64) {
+            ok = ok && agreements == committed;
+        }
+    }
+
+    // The same half second window at any frame rate, with the work per
+    // frame bounded by the depth cap
+    for (double fps : {60.0, 120.0, 250.0}) {
+        SpotsGenerator generator(20, false, fps);
+        SpotsTracker tracker(panel);
+        double tracker_time = 0.0;
+        double time = 0.0;
+        for (int i = 0; i < frames; i++) {
+            vector< Spot > spots = generator.next(i, time);
+            auto begin = steady_clock::now();
+            tracker.push_back(spots, time);
+            if (i >= span) {
+                tracker.front();
+                tracker.pop_front();
+            }
+            auto end = steady_clock::now();
+            tracker_time += duration_cast< duration< double, milli > >(end - begin).count();
+        }
+        cerr << "20 spots per frame at " << fps << " fps: tracker " << tracker_time / frames << "ms per frame" << endl;
+    }
+
+    // The costs fixed at compile time give the same tracks as the
+    // default ones on the trackbars
+    for (int limit : {5, 20, 50}) {
+        SpotsGenerator generator(limit, false);
+        SpotsTracker runtime(panel);
+        FixedSpotsTracker fixed;
+        double runtime_time = 0.0, fixed_time = 0.0;
+        int mismatches = 0;
+        double time = 0.0;
+        for (int i = 0; i < frames; i++) {
+            vector< Spot > spots = generator.next(i, time);
+            auto begin = steady_clock::now();
+            runtime.push_back(spots, time);
+            tuple< bool, Point2f > runtime_position;
+            if (i >= span) {
+                runtime_position = runtime.front();
+                runtime.pop_front();
+            }
+            auto middle = steady_clock::now();
+            fixed.push_back(spots, time);
+            tuple< bool, Point2f > fixed_position;
+            if (i >= span) {
+                fixed_position = fixed.front();
+                fixed.pop_front();
+            }
+            auto end = steady_clock::now();
+            runtime_time += duration_cast< duration< double, milli > >(middle - begin).count();
+            fixed_time += duration_cast< duration< double, milli > >(end - middle).count();
+            mismatches += runtime_position != fixed_position;
+        }
+        cerr << limit << " spots per frame: runtime costs " << runtime_time / frames << "ms, fixed costs "
+             << fixed_time / frames << "ms per frame, " << mismatches << " mismatches" << endl;
+        ok = ok && mismatches == 0;
+    }
+
+    // A tracker resumed from the state saved halfway (or early, while
+    // the ring still has the initial phantom frame) gives the same
+    // positions as the one that went on, for all the frames after the
+    // ones still pending when the state was saved
+    for (bool lattice : {false, true}) for (int limit : {5, 20, 50}) for (int cut : {span / 2, (frames - span) / 2}) {
+        SpotsGenerator generator(limit, lattice);
+        SpotsTracker tracker(panel), resumed(panel);
+        vector< tuple< bool, Point2f > > expected(frames);
+        int mismatches = 0, compared = 0;
+        double time = 0.0;
+        for (int i = 0; i < frames; i++) {
+            vector< Spot > spots = generator.next(i, time);
+            tracker.push_back(spots, time);
+            if (i >= span) {
+                expected[i - span] = tracker.front();
+                tracker.pop_front();
+            }
+
+            if (i == cut) {
+                ostringstream out;
+                tracker.write_state(out);
+                string state = out.str();
+                // A truncated state is refused
+                istringstream truncated(state.substr(0, state.size() / 2));
+                ok = ok && !resumed.read_state(truncated);
+                // And so is a state with a field out of range: the front
+                // before the oldest frame, back_best, and the cols, the
+                // cell and the predecessor of the first node of the
+                // oldest frame
+                int32_t oldest;
+                memcpy(&oldest, state.data() + 8, sizeof(oldest));
+                for (auto field : vector< pair< size_t, int32_t > >{ {4, oldest - 1}, {12, 1 << 20}, {44, 0}, {52 + 24, -1}, {52 + 32, oldest} }) {
+                    string corrupted = state;
+                    memcpy(&corrupted[field.first], &field.second, sizeof(field.second));
+                    istringstream corrupted_in(corrupted);
+                    ok = ok && !resumed.read_state(corrupted_in);
+                }
+                istringstream in(state);
+                ok = ok && resumed.read_state(in);
+                resumed.drop_pending();
+            } else if (i > cut) {
+                resumed.push_back(spots, time);
+                if (i >= span && i - span > cut) {
+                    tuple< bool, Point2f > position = resumed.front();
+                    ok = ok && resumed.get_front_num() == i - span;
+                    resumed.pop_front();
+                    compared++;
+                    mismatches += position != expected[i - span];
+                }
+            }
+        }
+        cerr << limit << (lattice ? " lattice" : "") << " spots per frame, resumed at frame " << cut << ": "
+             << mismatches << " of " << compared << " frames differ" << endl;
+        ok = ok && mismatches == 0 && compared > 0;
+    }
+
+    return ok ? 0 : 1;
+}
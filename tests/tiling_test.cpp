@@ -0,0 +1,123 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "context.hpp"
+#include "half_float.hpp"
+#include "utility.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// Run the per-pixel analysis of the table frames of a recording with
+// different numbers of tiles, timing each stage and checking that the
+// results do not depend on the tiling
+struct tiling_run_t {
+    int tiles;
+    TableDescription table;
+    TableAnalysis table_analysis;
+    BallAnalysis ball_analysis;
+    Mat density;
+    double time[3] = { 0.0, 0.0, 0.0 };
+    double error[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+    tiling_run_t(int tiles, Size size) : tiles(tiles), table(size) {}
+};
+
+static double max_error(const Mat &a, const Mat &b) {
+    Mat a_float, b_float, diff;
+    load_map(a, a_float);
+    load_map(b, b_float);
+    absdiff(a_float, b_float, diff);
+    double res;
+    minMaxLoc(diff.reshape(1), NULL, &res);
+    return res;
+}
+
+static double elapsed(steady_clock::time_point &begin) {
+    auto end = steady_clock::now();
+    double res = duration_cast< duration< double, milli > >(end - begin).count();
+    begin = end;
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        cerr << "Usage: " << argv[0] << " <video> <reference subotto> [<reference subotto mask>]" << endl;
+        return 1;
+    }
+
+    control_panel_t panel;
+    init_control_panel(panel);
+    Mat ref_frame = imread(argv[2]);
+    Mat ref_mask;
+    if (argc == 4) {
+        ref_mask = imread(argv[3], CV_LOAD_IMAGE_GRAYSCALE);
+    }
+
+    SubtrackerContext ctx(ref_frame, ref_mask, panel, true);
+    Size size = ctx.frame_settings.table_frame_size;
+    BallDescription ball;
+
+    // The first run is the untiled reference
+    vector< int > tile_counts = { 1, 2, 4, 8, 16, choose_analysis_tiles(size) };
+    vector< tiling_run_t > runs;
+    for (int tiles : tile_counts) {
+        runs.emplace_back(tiles, size);
+    }
+
+    int frames = 0;
+    auto f = open_frame_cycle(argv[1], panel);
+    f->start();
+    while (true) {
+        auto frame_info = f->get();
+        if (!frame_info.valid) break;
+
+        ctx.feed(frame_info.data, frame_info.time);
+
+        FrameAnalysis *frame;
+        while ((frame = ctx.get_processed_frame()) != NULL) {
+            for (auto &run : runs) {
+                auto begin = steady_clock::now();
+                do_table_analysis(panel, frame->table_frame, run.table, run.table_analysis, run.tiles);
+                run.time[0] += elapsed(begin);
+                do_ball_analysis(panel, frame->table_frame, ball, run.table_analysis, run.ball_analysis, run.density, run.tiles);
+                run.time[1] += elapsed(begin);
+                do_update_table_description(panel, frame->table_frame, run.table_analysis, run.table, &frame->foosmen_mask, run.tiles);
+                run.time[2] += elapsed(begin);
+
+                const tiling_run_t &ref = runs[0];
+                run.error[0] = max(run.error[0], max_error(run.table_analysis.nll, ref.table_analysis.nll));
+                run.error[1] = max(run.error[1], max_error(run.density, ref.density));
+                run.error[2] = max(run.error[2], max_error(run.table.mean, ref.table.mean));
+                run.error[3] = max(run.error[3], max_error(run.table.variance, ref.table.variance));
+            }
+            frames++;
+            delete frame;
+        }
+    }
+    delete f;
+
+    cerr << "Frames: " << frames << ", table frame size " << size << ", " << getNumThreads() << " threads" << endl;
+    if (frames == 0) return 1;
+    bool ok = true;
+    for (const auto &run : runs) {
+        cerr << run.tiles << " tiles: table analysis " << run.time[0] / frames
+             << "ms, ball analysis " << run.time[1] / frames
+             << "ms, table update " << run.time[2] / frames << "ms per frame" << endl;
+        cerr << "\tmax error: table NLL " << run.error[0] << ", ball density " << run.error[1]
+             << ", mean " << run.error[2] << ", variance " << run.error[3] << endl;
+        // The box filter keeps running sums along the columns, whose
+        // rounding depends on where a tile starts; anything more than
+        // that is a bug in the tiling
+        for (int i = 0; i < 4; i++) {
+            ok = ok && run.error[i] < 1e-3;
+        }
+    }
+    cerr << (ok ? "Tiled results match" : "Tiled results DO NOT match") << endl;
+
+    return ok ? 0 : 1;
+}